@@ -0,0 +1,297 @@
+// bench.cpp
+// Host-side pipeline benchmark for usb2atari: no pad, no FT245, no window.
+// - Builds the application core (src/main.cpp without main()) against a mock
+//   D2XX (mock_ftd2xx.cpp) and drives it with synthetic input streams:
+//     snapshot (storeJoystickSnapshot) -> BindPlan::eval -> PressLatch
+//     -> Ft245BitBang::writePads
+//   The reference path (VirtualPad::sample + packBits6ActiveLow) is timed too.
+// - --replay FILE pushes a --record log through the same output path.
+// - Reports ns per tick, heap allocations per tick and throughput for
+//   2..N pads. --fail-ns / --fail-alloc turn it into a regression gate;
+//   debug builds fail on any allocation after the warm-up tick by default.
+//
+// usage: usb2atari_bench [--ticks N] [--max-pads N] [--replay FILE]
+//                        [--fail-ns NS] [--fail-alloc]
+
+#define USB2ATARI_NO_MAIN
+#include "main.cpp"
+
+#include <new>
+
+uint64_t mockFt245Bytes();
+uint64_t mockFt245Writes();
+
+// -----------------------------------------------------------------------------
+// Allocation counter (every operator new in the process)
+// -----------------------------------------------------------------------------
+static std::atomic<uint64_t> gAllocs{0};
+
+void* operator new(std::size_t n) {
+  gAllocs.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(n ? n : 1)) return p;
+  throw std::bad_alloc();
+}
+void* operator new[](std::size_t n) { return operator new(n); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+#ifdef NDEBUG
+static constexpr bool kFailAllocDefault = false;
+#else
+static constexpr bool kFailAllocDefault = true;
+#endif
+
+// -----------------------------------------------------------------------------
+// Synthetic input sources
+// - Every pad gets a full set of bindings of one kind (or a mix); each tick a
+//   deterministic LCG flips roughly one input in sixteen.
+// - Each pad's joystick is a fake device: raw arrays + gamepad state that are
+//   stored through the same storeJoystickSnapshot() as GLFW's.
+// -----------------------------------------------------------------------------
+enum class Source { Keys, Buttons, Axes, Mixed, Count };
+
+static const char* sourceName(Source s) {
+  switch (s) {
+    case Source::Keys: return "keys";
+    case Source::Buttons: return "buttons";
+    case Source::Axes: return "axes";
+    case Source::Mixed: return "mixed";
+    default: return "?";
+  }
+}
+
+static uint32_t gRng = 0x12345678u;
+static uint32_t nextRand() {
+  gRng = gRng * 1664525u + 1013904223u;
+  return gRng >> 8;
+}
+
+static void setKey(int key, bool down) {
+  const uint64_t m = 1ull << (key & 63);
+  gKeyDown[key] = down;
+  if (down) gKeyBits[key >> 6] |= m;
+  else gKeyBits[key >> 6] &= ~m;
+}
+
+struct FakeJoystick {
+  unsigned char btn[16];
+  float axis[6];
+  GLFWgamepadstate gp;
+};
+static FakeJoystick gFakeJoy[kJoyCount];
+
+static void storeFakeJoystick(int jid) {
+  const FakeJoystick& f = gFakeJoy[jid];
+  storeJoystickSnapshot(jid, f.btn, 16, f.axis, 6, &f.gp);
+}
+
+static const int kBenchKeys[6] = {GLFW_KEY_W, GLFW_KEY_S, GLFW_KEY_A, GLFW_KEY_D, GLFW_KEY_J, GLFW_KEY_K};
+
+static void setupSource(Source src, int pads) {
+  for (int i = 0; i < kMaxPads; ++i) gPad[i] = VirtualPad();
+  for (int jid = 0; jid < kJoyCount; ++jid) {
+    gJoy[jid] = JoyCache();
+    flattenJoystick(jid);
+  }
+  std::memset(gKeyDown, 0, sizeof(gKeyDown));
+  std::memset(gKeyBits, 0, sizeof(gKeyBits));
+
+  for (int p = 0; p < pads; ++p) {
+    const int jid = p % kJoyCount;
+    JoyCache& jc = gJoy[jid];
+    jc.present = true;
+    jc.isGamepad = true;
+    std::snprintf(jc.name, sizeof(jc.name), "bench pad %d", jid);
+    gFakeJoy[jid] = FakeJoystick();
+    storeFakeJoystick(jid);
+
+    Source s = src == Source::Mixed ? (Source)(p % 3) : src;
+    for (int k = 0; k < (int)VKey::Count; ++k) {
+      Binding& b = gPad[p].bind[k];
+      b.jid = jid;
+      if (s == Source::Keys) {
+        b.type = BindType::Key;
+        b.jid = -1;
+        b.code = kBenchKeys[k] + p;
+      } else if (s == Source::Buttons) {
+        b.type = (k & 1) ? BindType::JoyButton : BindType::GamepadButton;
+        b.code = k;
+      } else {
+        b.type = (k & 1) ? BindType::JoyAxisDir : BindType::GamepadAxisDir;
+        b.code = k / 2;
+        b.dir = (k & 1) ? 1 : -1;
+      }
+    }
+  }
+  gPadCount = pads;
+  rebuildBindPlan();
+}
+
+// One synthetic tick of input changes
+static void mutateInputs(int pads) {
+  for (int p = 0; p < pads; ++p) {
+    const uint32_t r = nextRand();
+    if ((r & 15) != 0) continue;
+    const int k = (int)((r >> 4) % 6);
+    const int key = gPad[p].bind[k].type == BindType::Key ? gPad[p].bind[k].code : kBenchKeys[k];
+    setKey(key, !gKeyDown[key]);
+
+    FakeJoystick& f = gFakeJoy[p % kJoyCount];
+    f.gp.buttons[k] ^= 1;
+    f.btn[k] ^= 1;
+    const float v = ((int)((r >> 8) % 201) - 100) / 100.0f;
+    f.gp.axes[k / 2] = v;
+    f.axis[k / 2] = -v;
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Runs
+// -----------------------------------------------------------------------------
+struct BenchResult {
+  double planNs = 0.0;      // snapshot + eval + latch + writePads, per tick
+  double refNs = 0.0;       // snapshot + VirtualPad::sample + pack + latch + writePads
+  double allocsPerTick = 0.0;
+  double bytesPerTick = 0.0;
+};
+
+static std::vector<std::unique_ptr<Ft245BitBang>> openMockDevices(int pads) {
+  std::vector<std::unique_ptr<Ft245BitBang>> devs;
+  for (int p = 0; p < pads; p += 2) {
+    std::unique_ptr<Ft245BitBang> d(new Ft245BitBang());
+    d->open((int)devs.size(), pads - p >= 2 ? Ft245Layout::Mux2 : Ft245Layout::Single);
+    devs.push_back(std::move(d));
+  }
+  return devs;
+}
+
+template <typename Eval>
+static double timeTicks(int pads, int ticks, std::vector<std::unique_ptr<Ft245BitBang>>& devs,
+                        uint64_t& allocs, uint64_t& bytes, Eval eval) {
+  uint64_t total = 0;
+  uint8_t bits6[kMaxPads];
+  uint64_t a0 = gAllocs.load();
+  const uint64_t b0 = mockFt245Bytes();
+  gPressLatch.setMinPulseNs(20000);   // many bench ticks, so holds and merges happen
+  // Tick 0 is the warm-up; allocations are counted from tick 1 on.
+  for (int t = 0; t <= ticks; ++t) {
+    if (t == 1) a0 = gAllocs.load();
+    mutateInputs(pads);
+    const uint64_t t0 = nowNs();
+    for (int p = 0; p < pads; ++p) storeFakeJoystick(p % kJoyCount);
+    std::memset(bits6, 0x3F, sizeof(bits6));
+    eval(bits6);
+    gPressLatch.apply(bits6, pads, t0);
+    for (size_t d = 0; d < devs.size(); ++d) devs[d]->writePads(bits6 + 2 * d);
+    if (t) total += nowNs() - t0;
+  }
+  allocs = gAllocs.load() - a0;
+  bytes = mockFt245Bytes() - b0;
+  return (double)total / ticks;
+}
+
+static BenchResult runSynthetic(Source src, int pads, int ticks) {
+  setupSource(src, pads);
+  std::vector<std::unique_ptr<Ft245BitBang>> devs = openMockDevices(pads);
+  BenchResult r;
+  uint64_t allocs = 0, bytes = 0, refAllocs = 0, refBytes = 0;
+
+  gRng = 0x12345678u;
+  r.planNs = timeTicks(pads, ticks, devs, allocs, bytes, [](uint8_t* out) { gPlans.current().eval(out); });
+
+  gRng = 0x12345678u;
+  r.refNs = timeTicks(pads, ticks, devs, refAllocs, refBytes, [pads](uint8_t* out) {
+    for (int p = 0; p < pads; ++p) out[p] = packBits6ActiveLow(gPad[p].sample());
+  });
+
+  r.allocsPerTick = (double)allocs / ticks;
+  r.bytesPerTick = (double)bytes / ticks;
+  return r;
+}
+
+// Replays a --record log through writePads as fast as possible.
+static bool runReplayBench(const char* path) {
+  MappedFile f;
+  if (!f.open(path) || f.size() < kRecHeaderSize || std::memcmp(f.data(), kRecMagic, sizeof(kRecMagic)) != 0) {
+    std::fprintf(stderr, "[bench] %s is not a usb2atari recording\n", path);
+    return false;
+  }
+  const int pads = f.data()[7];
+  if (pads < 1 || pads > kMaxPads) return false;
+  std::vector<std::unique_ptr<Ft245BitBang>> devs = openMockDevices(pads);
+
+  ReplayCursor c;
+  c.p = f.data() + kRecHeaderSize;
+  c.end = f.data() + f.size();
+  c.padCount = pads;
+  std::memset(c.bits6, 0x3F, sizeof(c.bits6));
+
+  uint64_t entries = 0;
+  const uint64_t a0 = gAllocs.load();
+  const uint64_t b0 = mockFt245Bytes();
+  const uint64_t t0 = nowNs();
+  while (c.next()) {
+    for (size_t d = 0; d < devs.size(); ++d) devs[d]->writePads(c.bits6 + 2 * d);
+    ++entries;
+  }
+  const uint64_t dt = nowNs() - t0;
+  std::printf("replay %s: %d pad(s), %llu entries over %.1f s recorded\n",
+    path, pads, (unsigned long long)entries, c.tUs / 1e6);
+  if (entries) {
+    std::printf("  %.1f ns/entry, %.0f entries/s, %.3f allocs/entry, %.2f bytes/entry\n",
+      (double)dt / entries, entries * 1e9 / (double)(dt ? dt : 1),
+      (double)(gAllocs.load() - a0) / entries, (double)(mockFt245Bytes() - b0) / entries);
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  int ticks = 200000;
+  int maxPads = kMaxPads;
+  const char* replay = nullptr;
+  double failNs = 0.0;
+  bool failAlloc = kFailAllocDefault;
+
+  for (int i = 1; i < argc; ++i) {
+    const char* a = argv[i];
+    if (std::strcmp(a, "--ticks") == 0 && i + 1 < argc) ticks = (std::max)(1, std::atoi(argv[++i]));
+    else if (std::strcmp(a, "--max-pads") == 0 && i + 1 < argc) maxPads = (std::min)(kMaxPads, (std::max)(2, std::atoi(argv[++i])));
+    else if (std::strcmp(a, "--replay") == 0 && i + 1 < argc) replay = argv[++i];
+    else if (std::strcmp(a, "--fail-ns") == 0 && i + 1 < argc) failNs = std::atof(argv[++i]);
+    else if (std::strcmp(a, "--fail-alloc") == 0) failAlloc = true;
+    else {
+      std::fprintf(stderr, "usage: %s [--ticks N] [--max-pads N] [--replay FILE] [--fail-ns NS] [--fail-alloc]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  bool failed = false;
+  std::printf("%-8s %4s %12s %12s %12s %12s %10s\n",
+    "source", "pads", "plan ns/tick", "ref ns/tick", "Mticks/s", "allocs/tick", "B/tick");
+  // Powers of two below maxPads, then maxPads itself.
+  int padCounts[kMaxPads];
+  int padRuns = 0;
+  for (int pads = 2; pads < maxPads; pads *= 2) padCounts[padRuns++] = pads;
+  padCounts[padRuns++] = maxPads;
+
+  for (int s = 0; s < (int)Source::Count; ++s) {
+    for (int k = 0; k < padRuns; ++k) {
+      const int pads = padCounts[k];
+      BenchResult r = runSynthetic((Source)s, pads, ticks);
+      std::printf("%-8s %4d %12.1f %12.1f %12.2f %12.3f %10.2f\n",
+        sourceName((Source)s), pads, r.planNs, r.refNs, 1e3 / r.planNs, r.allocsPerTick, r.bytesPerTick);
+      if (failNs > 0.0 && r.planNs > failNs) failed = true;
+      if (failAlloc && r.allocsPerTick > 0.0) failed = true;
+    }
+  }
+
+  if (replay && !runReplayBench(replay)) return 1;
+
+  if (failed) {
+    std::fprintf(stderr, "[bench] regression gate failed (--fail-ns %.1f%s)\n", failNs, failAlloc ? ", --fail-alloc" : "");
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,84 @@
+// mock_ftd2xx.cpp
+// Stand-in for the FTDI D2XX library used by usb2atari_bench.
+// - Every FT_Open/FT_OpenEx succeeds; FT_Write returns immediately and only
+//   counts bytes, so the benchmark measures the host-side pipeline alone.
+// - Only the entry points main.cpp actually calls are provided.
+
+#include "ftd2xx.h"
+
+#include <cstdint>
+#include <cstring>
+
+static uint64_t gMockBytes = 0;
+static uint64_t gMockWrites = 0;
+static UCHAR gMockPins = 0xFF;
+
+uint64_t mockFt245Bytes() { return gMockBytes; }
+uint64_t mockFt245Writes() { return gMockWrites; }
+
+extern "C" {
+
+FT_STATUS WINAPI FT_Open(int deviceNumber, FT_HANDLE* pHandle) {
+  *pHandle = (FT_HANDLE)(intptr_t)(0x1000 + deviceNumber);
+  return FT_OK;
+}
+
+FT_STATUS WINAPI FT_OpenEx(PVOID pArg1, DWORD Flags, FT_HANDLE* pHandle) {
+  (void)pArg1;
+  (void)Flags;
+  *pHandle = (FT_HANDLE)(intptr_t)0x2000;
+  return FT_OK;
+}
+
+FT_STATUS WINAPI FT_Close(FT_HANDLE) { return FT_OK; }
+FT_STATUS WINAPI FT_ResetDevice(FT_HANDLE) { return FT_OK; }
+FT_STATUS WINAPI FT_Purge(FT_HANDLE, ULONG) { return FT_OK; }
+FT_STATUS WINAPI FT_SetBaudRate(FT_HANDLE, ULONG) { return FT_OK; }
+FT_STATUS WINAPI FT_SetLatencyTimer(FT_HANDLE, UCHAR) { return FT_OK; }
+FT_STATUS WINAPI FT_SetUSBParameters(FT_HANDLE, ULONG, ULONG) { return FT_OK; }
+FT_STATUS WINAPI FT_SetTimeouts(FT_HANDLE, ULONG, ULONG) { return FT_OK; }
+FT_STATUS WINAPI FT_SetBitMode(FT_HANDLE, UCHAR, UCHAR) { return FT_OK; }
+FT_STATUS WINAPI FT_SetDataCharacteristics(FT_HANDLE, UCHAR, UCHAR, UCHAR) { return FT_OK; }
+FT_STATUS WINAPI FT_SetFlowControl(FT_HANDLE, USHORT, UCHAR, UCHAR) { return FT_OK; }
+
+FT_STATUS WINAPI FT_GetBitMode(FT_HANDLE, PUCHAR pucMode) {
+  *pucMode = gMockPins;
+  return FT_OK;
+}
+
+FT_STATUS WINAPI FT_Write(FT_HANDLE, LPVOID lpBuffer, DWORD dwBytesToWrite, LPDWORD lpBytesWritten) {
+  if (dwBytesToWrite) gMockPins = ((const UCHAR*)lpBuffer)[dwBytesToWrite - 1];
+  gMockBytes += dwBytesToWrite;
+  ++gMockWrites;
+  *lpBytesWritten = dwBytesToWrite;
+  return FT_OK;
+}
+
+FT_STATUS WINAPI FT_Read(FT_HANDLE, LPVOID lpBuffer, DWORD dwBytesToRead, LPDWORD lpBytesReturned) {
+  std::memset(lpBuffer, gMockPins, dwBytesToRead);
+  *lpBytesReturned = dwBytesToRead;
+  return FT_OK;
+}
+
+FT_STATUS WINAPI FT_GetQueueStatus(FT_HANDLE, DWORD* dwRxBytes) {
+  *dwRxBytes = 0;
+  return FT_OK;
+}
+
+FT_STATUS WINAPI FT_GetStatus(FT_HANDLE, DWORD* dwRxBytes, DWORD* dwTxBytes, DWORD* dwEventDWord) {
+  *dwRxBytes = 0;
+  *dwTxBytes = 0;
+  *dwEventDWord = 0;
+  return FT_OK;
+}
+
+FT_STATUS WINAPI FT_CreateDeviceInfoList(LPDWORD lpdwNumDevs) {
+  *lpdwNumDevs = 0;
+  return FT_OK;
+}
+
+FT_STATUS WINAPI FT_GetDeviceInfoDetail(DWORD, LPDWORD, LPDWORD, LPDWORD, LPDWORD, LPVOID, LPVOID, FT_HANDLE*) {
+  return FT_DEVICE_NOT_FOUND;
+}
+
+} // extern "C"
@@ -1,20 +1,69 @@
 // main_glfw_padviz.cpp
-// GLFW + OpenGL fixed pipeline visualization for 2x virtual pads (6-bit each).
-// - Two virtual controllers: each has Up/Down/Left/Right/B1/B2 (digital)
+// GLFW + OpenGL fixed pipeline visualization for N virtual pads (6-bit each, default 2).
+// - Virtual controllers: each has Up/Down/Left/Right/B1/B2 (digital)
 // - Rebind any virtual control to keyboard or any joystick/gamepad input (learning mode)
-// - Render two pad diagrams and highlight current states
+// - Render the pad diagrams and highlight current states
+// - Drive the pads onto one or more outputs (FT245 bit-bang, UART, UDP, null;
+//   one writer thread per output)
 // - Show current bindings on screen in real time
 // - Save/Load bindings to a text file
 //
 // Hotkeys:
 //   ESC            : quit
 //   F5             : save bindings to "padmap.txt"
-//   F9             : load bindings from "padmap.txt"
+//   F9             : reload bindings from "padmap.txt" (also picked up when the file changes)
+//   F3             : dump input->pin latency histograms to stderr (also at exit)
+//   F4             : toggle the live telemetry panel
+//   F6             : measure the FT245 USB transfer settings again (ftdi_tune.txt)
+//   F8             : write a Chrome trace of the last seconds (needs --trace FILE)
 //   F1 / F2        : select virtual controller 1 / 2 for editing
 //   1..6           : select target control (1:Up 2:Down 3:Left 4:Right 5:B1 6:B2)
 //   SPACE          : start learning (next input becomes new binding)
 //   BACKSPACE      : clear binding for selected control
-//   TAB            : cycle selected controller
+//   TAB            : cycle selected controller (all pads)
+//
+// Command line:
+//   --rate HZ      : input sampling / FT245 output rate (default 1000)
+//   --output MODE  : single = one pad on D0..D5 (default)
+//                    mux    = two pads in one FT_Write, D6 pad select, D7 strobe
+//                    uart   = two pads in a 1-2 byte UART frame (--uart-baud N)
+//                    null   = no device (host-side timing only)
+//   --device SERIAL[:MODE] : open FT245 by serial number (repeatable); each device
+//                    takes the next 1 (single) or 2 (mux/uart) pads in order
+//   --pads N       : number of virtual pads (default: 2, or what the devices carry)
+//   --list-devices : print the FTDI devices found and exit
+//   --headless     : no window / GL context; load padmap.txt and only run
+//                    sample (BindPlan::eval) -> writeBits6 (logs to stderr)
+//   --latency-test N : measure N FT245 host->pin->host round trips and exit
+//   --probe INDEX    : use a second FTDI device as the pin probe for the test
+//   --turbo PAD:BTN:HZ : auto-fire a button while held (repeatable)
+//   --macro KEY:PAD:STEPS : key plays a timed sequence, e.g. 68:1:D*1,DR*1,R*1,1*2
+//   --min-pulse-us US : hold every press at least this long (default one target frame)
+//   --input native : also read pads on a native HID thread (evdev / XInput / IOHIDManager)
+//   --bitbang-rate N / --macro-frame-us US : waveform stream timing
+//                    (devices with turbo/macros stream via synchronous bit-bang)
+//   --record FILE  : log pad state changes to a compact binary file
+//   --replay FILE  : drive the FT245 devices from a log at its original timing
+//                    (no window, bindings ignored; --replay-loop repeats it)
+//   --ui-fps N     : max UI frame rate (default 60); the UI only redraws on change
+//   --udp-send HOST:PORT : also stream pad states over UDP to a remote instance
+//   --udp-listen [HOST:]PORT : drive the FT245 devices from a remote instance
+//                    (no window, bindings ignored)
+//   --rt / --cpu N / --spin-us US : real-time priority, CPU pinning, pacing spin
+//   --stats-file FILE [--stats-format json|csv] [--stats-interval MS] :
+//                    periodic telemetry lines (same counters as the F4 panel)
+//   --vsync D6|D7 [--vsync-edge rise|fall] [--vsync-offset-us US] [--vsync-lead-us US] :
+//                    lock sampling to the target's VSYNC on a single-mode FT245 input pin
+//   --trace FILE [--trace-threshold-us US] : record timeline zones; F8 or a tick /
+//                    wake-up over US writes them as Chrome trace JSON to FILE-N.json
+//   --ftdi-tune auto|force|off : per-serial FT245 latency timer / USB transfer size /
+//                    bit-bang clock, measured at first open and kept in ftdi_tune.txt
+//
+// Threads:
+// - GLFW wants event processing and joystick queries on the main thread, so the
+//   main thread runs the paced input -> FT245 loop at --rate, independent of vsync.
+// - Rendering runs on its own thread that owns the GL context and only reads
+//   the latest published pad state (see UiSnapshot).
 //
 // Notes for learning:
 // - When learning is armed, the first detected input wins:
@@ -37,6 +86,11 @@
 
 #ifdef _WIN32
   #define _CRT_SECURE_NO_WARNINGS
+  // winsock2.h has to come before anything that pulls in windows.h
+  #include <winsock2.h>
+  #include <ws2tcpip.h>
+  #include <windows.h>
+  #include <mmsystem.h>
 #endif
 #include <GLFW/glfw3.h>
 
@@ -51,6 +105,41 @@
 #include <algorithm>
 #include <cstdint>
 #include <cmath>
+#include <csignal>
+#include <cerrno>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#if defined(_WIN32)
+  #include <xinput.h>
+#elif defined(__APPLE__)
+  #include <IOKit/hid/IOHIDManager.h>
+#elif defined(__linux__)
+  #include <dirent.h>
+  #include <linux/input.h>
+  #include <poll.h>
+  #include <sys/inotify.h>
+  #include <sys/ioctl.h>
+#endif
+
+#ifndef _WIN32
+  #include <arpa/inet.h>
+  #include <fcntl.h>
+  #include <netdb.h>
+  #include <netinet/in.h>
+  #include <pthread.h>
+  #include <sched.h>
+  #include <sys/mman.h>
+  #include <sys/socket.h>
+  #include <sys/stat.h>
+  #include <time.h>
+  #include <unistd.h>
+#endif
 
 #if defined(__APPLE__) || defined(MACOSX)
   #pragma GCC diagnostic ignored "-Wdeprecated-declarations"
@@ -71,12 +160,624 @@ static int gFBH = 0;
 #include "stb_easy_font.h"
 
 
+// -----------------------------------------------------------------------------
+// Latency instrumentation
+// - nowNs(): monotonic high-resolution clock used for all pipeline timestamps.
+// - LatencyHistogram: log-linear buckets (16 per power of two, ~6% resolution),
+//   fixed size, no allocation. Recorded and dumped on the I/O thread only.
+// -----------------------------------------------------------------------------
+static inline uint64_t nowNs() {
+  using namespace std::chrono;
+  return (uint64_t)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+struct LatencyHistogram {
+  static constexpr int kSubBits = 4;
+  static constexpr int kSub = 1 << kSubBits;
+  static constexpr int kBuckets = (64 - kSubBits + 1) * kSub;
+
+  uint64_t bucket[kBuckets] = {};
+  uint64_t count = 0;
+  uint64_t maxNs = 0;
+
+  static int msb(uint64_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - __builtin_clzll(v);
+#else
+    int m = 0;
+    while (v >>= 1) ++m;
+    return m;
+#endif
+  }
+
+  static int indexOf(uint64_t ns) {
+    if (ns < (uint64_t)kSub) return (int)ns;
+    int shift = msb(ns) - kSubBits;
+    return (shift + 1) * kSub + (int)((ns >> shift) & (kSub - 1));
+  }
+
+  // Upper bound (inclusive) of the values that land in bucket i.
+  static uint64_t upperOf(int i) {
+    if (i < kSub) return (uint64_t)i;
+    int shift = i / kSub - 1;
+    uint64_t sub = (uint64_t)(i % kSub);
+    return ((kSub + sub + 1) << shift) - 1;
+  }
+
+  void record(uint64_t ns) {
+    ++bucket[indexOf(ns)];
+    ++count;
+    if (ns > maxNs) maxNs = ns;
+  }
+
+  uint64_t percentile(double q) const {
+    if (count == 0) return 0;
+    uint64_t rank = (uint64_t)std::ceil(q * (double)count);
+    if (rank < 1) rank = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < kBuckets; ++i) {
+      seen += bucket[i];
+      if (seen >= rank) return (std::min)(upperOf(i), maxNs);
+    }
+    return maxNs;
+  }
+};
+
+// Pipeline stages of one I/O tick. "eval" covers binding evaluation and packing,
+// which the compiled plan does in one pass. FT_Write timing is recorded per
+// device by its writer thread (see OutputWriter).
+struct PipelineLatency {
+  LatencyHistogram poll;        // glfwPollEvents + joystick snapshot
+  LatencyHistogram eval;        // BindPlan::eval (evaluate + pack)
+  LatencyHistogram tick;        // whole tick, excluding the pacing sleep
+  LatencyHistogram keyFast;     // key event -> writer submit via the fast path
+  LatencyHistogram jitter;      // pacing wake-up - tick deadline
+};
+
+static PipelineLatency gLat;
+
+static void dumpLatencyRow(std::FILE* fp, const char* name, const LatencyHistogram& h) {
+  std::fprintf(fp, "[lat] %-12s %10llu %10.1f %10.1f %10.1f\n",
+    name,
+    (unsigned long long)h.count,
+    (double)h.percentile(0.50) / 1000.0,
+    (double)h.percentile(0.99) / 1000.0,
+    (double)h.maxNs / 1000.0);
+}
+
+static void dumpLatencyStats(std::FILE* fp) {
+  std::fprintf(fp, "[lat] %-12s %10s %10s %10s %10s\n", "stage", "count", "p50(us)", "p99(us)", "max(us)");
+  dumpLatencyRow(fp, "poll", gLat.poll);
+  dumpLatencyRow(fp, "eval", gLat.eval);
+  dumpLatencyRow(fp, "tick", gLat.tick);
+  dumpLatencyRow(fp, "key->submit", gLat.keyFast);
+  dumpLatencyRow(fp, "jitter", gLat.jitter);
+}
+
+// -----------------------------------------------------------------------------
+// Timeline tracing (--trace FILE, F8, --trace-threshold-us US)
+// - TRACE_ZONE("name") times the rest of the scope into the calling thread's
+//   ring; traceEvent() records a span the caller has already timed. With
+//   tracing off a zone costs one relaxed load.
+// - Each thread claims a ring (kTraceEvents, oldest overwritten) on its first
+//   event and is its only writer. A dump copies the rings seqlock-style: the
+//   head moves before a slot is rewritten, so slots that changed under the
+//   copy are dropped instead of torn.
+// - F8, or a tick or pacing wake-up over --trace-threshold-us, asks the dump
+//   thread to write Chrome trace JSON (chrome://tracing, ui.perfetto.dev) to
+//   FILE-N.json 100 ms later, so the dump also shows what followed.
+// -----------------------------------------------------------------------------
+static constexpr int kTraceThreads = 16;
+static constexpr uint64_t kTraceEvents = 1u << 14;   // per thread: ~2.5 s of a 1 kHz I/O loop
+
+struct TraceRing {
+  struct Event {
+    std::atomic<const char*> name{nullptr};
+    std::atomic<uint64_t> t0{0};
+    std::atomic<uint64_t> t1{0};
+  };
+  char threadName[32] = {};
+  std::atomic<uint64_t> head{0};   // events started (slot head-1 may be mid-write)
+  std::atomic<uint64_t> done{0};   // events complete
+  Event ev[kTraceEvents];
+};
+
+static std::atomic<bool> gTraceOn{false};
+static std::atomic<int> gTraceRingCount{0};
+static std::atomic<TraceRing*> gTraceRings[kTraceThreads] = {};
+static std::atomic<uint64_t> gTraceLost{0};   // events of threads beyond kTraceThreads
+static thread_local TraceRing* tTraceRing = nullptr;
+static thread_local bool tTraceNoRing = false;
+static thread_local char tTraceThreadName[32] = {};
+
+// Names the calling thread in dumps. Call before its first zone.
+static void traceSetThreadName(const char* name) {
+  std::snprintf(tTraceThreadName, sizeof(tTraceThreadName), "%s", name);
+}
+
+static TraceRing* traceClaimRing() {
+  if (tTraceNoRing) return nullptr;
+  const int i = gTraceRingCount.fetch_add(1);
+  if (i >= kTraceThreads) {
+    tTraceNoRing = true;
+    return nullptr;
+  }
+  TraceRing* r = new TraceRing();   // once per thread, kept until exit
+  std::snprintf(r->threadName, sizeof(r->threadName), "%s", tTraceThreadName[0] ? tTraceThreadName : "thread");
+  gTraceRings[i].store(r, std::memory_order_release);
+  tTraceRing = r;
+  return r;
+}
+
+// name must be a string literal (dumps keep the pointer).
+static inline void traceEvent(const char* name, uint64_t t0, uint64_t t1) {
+  if (!gTraceOn.load(std::memory_order_relaxed)) return;
+  TraceRing* r = tTraceRing ? tTraceRing : traceClaimRing();
+  if (!r) {
+    gTraceLost.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  const uint64_t h = r->head.load(std::memory_order_relaxed);
+  r->head.store(h + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  TraceRing::Event& e = r->ev[h % kTraceEvents];
+  e.name.store(name, std::memory_order_relaxed);
+  e.t0.store(t0, std::memory_order_relaxed);
+  e.t1.store(t1, std::memory_order_relaxed);
+  r->done.store(h + 1, std::memory_order_release);
+}
+
+class TraceZone {
+ public:
+  explicit TraceZone(const char* name)
+    : name_(name), t0_(gTraceOn.load(std::memory_order_relaxed) ? nowNs() : 0) {}
+  ~TraceZone() { if (t0_) traceEvent(name_, t0_, nowNs()); }
+  TraceZone(const TraceZone&) = delete;
+  TraceZone& operator=(const TraceZone&) = delete;
+
+ private:
+  const char* name_;
+  uint64_t t0_;
+};
+
+#define TRACE_CONCAT2(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT2(a, b)
+#define TRACE_ZONE(name) TraceZone TRACE_CONCAT(traceZone_, __LINE__)(name)
+
+class TraceDumper {
+ public:
+  static constexpr uint64_t kTraceAfterNs = 100000000ull;      // context kept after a trigger
+  static constexpr uint64_t kAutoCooldownNs = 1000000000ull;   // between threshold dumps
+  static constexpr int kMaxAutoDumps = 16;
+
+  ~TraceDumper() { stop(); }
+
+  // thresholdUs 0 = dump on F8 only.
+  void start(const std::string& path, uint32_t thresholdUs) {
+    path_ = path;
+    thresholdNs_ = (uint64_t)thresholdUs * 1000u;
+    stop_ = false;
+    gTraceOn.store(true, std::memory_order_relaxed);
+    th_ = std::thread(&TraceDumper::run, this);
+  }
+
+  void stop() {
+    {
+      std::lock_guard<std::mutex> lock(m_);
+      stop_ = true;
+    }
+    cv_.notify_one();
+    if (th_.joinable()) th_.join();
+    gTraceOn.store(false, std::memory_order_relaxed);
+  }
+
+  bool enabled() const { return gTraceOn.load(std::memory_order_relaxed); }
+
+  // Asks for a dump kTraceAfterNs from now; a request already pending absorbs it.
+  void request(const char* reason, uint64_t valueNs) {
+    if (!enabled()) return;
+    std::lock_guard<std::mutex> lock(m_);
+    if (requestNs_) return;
+    requestNs_ = nowNs();
+    reason_ = reason;
+    valueNs_ = valueNs;
+  }
+
+  // I/O thread: dumps on a value over --trace-threshold-us, rate limited.
+  void check(const char* what, uint64_t ns) {
+    if (!thresholdNs_ || ns <= thresholdNs_ || autoDumps_ >= kMaxAutoDumps) return;
+    const uint64_t now = nowNs();
+    if (lastAutoNs_ && now - lastAutoNs_ < kAutoCooldownNs) return;
+    lastAutoNs_ = now;
+    if (++autoDumps_ == kMaxAutoDumps) {
+      std::fprintf(stderr, "[trace] %d threshold dumps, no more this run\n", kMaxAutoDumps);
+    }
+    request(what, ns);
+  }
+
+ private:
+  struct Copied {
+    const char* name;
+    uint64_t t0;
+    uint64_t t1;
+    int tid;
+  };
+
+  void run() {
+    std::unique_lock<std::mutex> lock(m_);
+    while (!stop_) {
+      cv_.wait_for(lock, std::chrono::milliseconds(20));
+      if (stop_) break;
+      const uint64_t t = requestNs_;
+      if (!t || nowNs() - t < kTraceAfterNs) continue;
+      requestNs_ = 0;
+      const char* reason = reason_;
+      const uint64_t value = valueNs_;
+      lock.unlock();
+      dump(t, reason, value);
+      lock.lock();
+    }
+    if (requestNs_) dump(requestNs_, reason_, valueNs_);   // triggered just before exit
+  }
+
+  std::string nextPath() {
+    const size_t slash = path_.find_last_of("/\\");
+    size_t dot = path_.find_last_of('.');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) dot = path_.size();
+    char n[16];
+    std::snprintf(n, sizeof(n), "-%d", ++dumps_);
+    return path_.substr(0, dot) + n + path_.substr(dot);
+  }
+
+  void dump(uint64_t tRequest, const char* reason, uint64_t valueNs) {
+    const int rings = (std::min)(gTraceRingCount.load(), kTraceThreads);
+    TraceRing* ring[kTraceThreads] = {};
+    events_.clear();
+    uint64_t base = tRequest;
+    for (int i = 0; i < rings; ++i) {
+      TraceRing* r = ring[i] = gTraceRings[i].load(std::memory_order_acquire);
+      if (!r) continue;
+      const size_t start = events_.size();
+      const uint64_t done = r->done.load(std::memory_order_acquire);
+      const uint64_t first = done > kTraceEvents ? done - kTraceEvents : 0;
+      for (uint64_t k = first; k < done; ++k) {
+        const TraceRing::Event& e = r->ev[k % kTraceEvents];
+        events_.push_back({e.name.load(std::memory_order_relaxed), e.t0.load(std::memory_order_relaxed),
+          e.t1.load(std::memory_order_relaxed), i + 1});
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      const uint64_t head = r->head.load(std::memory_order_relaxed);
+      // Slot k was rewritten under the copy once the writer started event k + kTraceEvents.
+      const uint64_t valid = head > kTraceEvents ? head - kTraceEvents : 0;
+      if (valid > first) events_.erase(events_.begin() + (ptrdiff_t)start,
+        events_.begin() + (ptrdiff_t)(start + (std::min)(valid - first, done - first)));
+      for (size_t k = start; k < events_.size(); ++k) base = (std::min)(base, events_[k].t0);
+    }
+
+    const std::string path = nextPath();
+    std::FILE* fp = std::fopen(path.c_str(), "w");
+    if (!fp) {
+      std::fprintf(stderr, "[trace] cannot open %s\n", path.c_str());
+      return;
+    }
+    std::fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    char what[64];
+    if (valueNs) std::snprintf(what, sizeof(what), "%s %.0f us", reason, (double)valueNs / 1000.0);
+    else std::snprintf(what, sizeof(what), "%s", reason);
+    std::fprintf(fp, "{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":0,\"ts\":%.3f}",
+      what, (double)(tRequest - base) / 1000.0);
+    for (int i = 0; i < rings; ++i) {
+      if (!ring[i]) continue;
+      std::fprintf(fp, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+        i + 1, ring[i]->threadName);
+    }
+    for (const Copied& c : events_) {
+      std::fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+        c.name, c.tid, (double)(c.t0 - base) / 1000.0, (double)(c.t1 - c.t0) / 1000.0);
+    }
+    std::fprintf(fp, "\n]}\n");
+    const bool ok = std::ferror(fp) == 0;
+    std::fclose(fp);
+    if (!ok) {
+      std::fprintf(stderr, "[trace] write to %s failed\n", path.c_str());
+      return;
+    }
+    std::fprintf(stderr, "[trace] wrote %s: %llu events (%s)\n", path.c_str(), (unsigned long long)events_.size(), what);
+  }
+
+  std::string path_;
+  uint64_t thresholdNs_ = 0;
+  uint64_t lastAutoNs_ = 0;     // I/O thread
+  int autoDumps_ = 0;           // I/O thread
+  uint64_t requestNs_ = 0;      // m_; 0 = no dump pending
+  const char* reason_ = "";     // m_
+  uint64_t valueNs_ = 0;        // m_
+  int dumps_ = 0;               // dump thread
+  std::vector<Copied> events_;  // dump thread
+  std::thread th_;
+  std::mutex m_;
+  std::condition_variable cv_;
+  bool stop_ = false;
+};
+
+static TraceDumper gTraceDumper;
+
+
+// -----------------------------------------------------------------------------
+// Real-time scheduling (--rt, --cpu N, --spin-us US)
+// - Pacing sleeps on the best timer the OS has until --spin-us before the
+//   deadline, then busy-waits the rest, so the wake-up error is the spin
+//   loop's, not the scheduler's:
+//     Windows: timeBeginPeriod(1) + a high-resolution waitable timer
+//              (CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, 10 1803+; a plain
+//              waitable timer before that).
+//     Linux:   clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME) (the clock
+//              behind nowNs()).
+//     macOS:   nanosleep.
+// - --rt raises the I/O thread, and the writer threads one step lower:
+//     Windows: THREAD_PRIORITY_TIME_CRITICAL / HIGHEST
+//     Linux:   SCHED_FIFO (needs CAP_SYS_NICE or an rtprio limit; without it
+//              we warn and stay at normal priority)
+//     macOS:   QOS_CLASS_USER_INTERACTIVE
+// - --cpu N pins the I/O thread to CPU N (not available on macOS).
+// - Tick jitter (wake-up time - deadline) goes to gLat.jitter.
+// -----------------------------------------------------------------------------
+#ifdef _WIN32
+  #ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+    #define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+  #endif
+#endif
+
+static bool gRealtime = false;   // --rt; read by threads as they start
+
+// step 0 = the I/O thread, 1 = writer threads.
+static void setThreadRealtime(const char* who, int step) {
+#ifdef _WIN32
+  if (!SetThreadPriority(GetCurrentThread(), step ? THREAD_PRIORITY_HIGHEST : THREAD_PRIORITY_TIME_CRITICAL)) {
+    std::fprintf(stderr, "[rt] %s: SetThreadPriority failed (%lu)\n", who, (unsigned long)GetLastError());
+  }
+#elif defined(__APPLE__)
+  (void)step;
+  if (pthread_set_qos_class_self_np(QOS_CLASS_USER_INTERACTIVE, 0) != 0) {
+    std::fprintf(stderr, "[rt] %s: QOS_CLASS_USER_INTERACTIVE refused\n", who);
+  }
+#else
+  // Mid-range priority: above normal work, below kernel/IRQ threads.
+  sched_param sp;
+  std::memset(&sp, 0, sizeof(sp));
+  sp.sched_priority = 50 - step;
+  const int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp);
+  if (err != 0) {
+    std::fprintf(stderr, "[rt] %s: SCHED_FIFO not permitted (%s), normal priority\n", who, std::strerror(err));
+  }
+#endif
+}
+
+static void setThreadCpu(int cpu) {
+#ifdef _WIN32
+  if (!SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu)) {
+    std::fprintf(stderr, "[rt] cannot pin to CPU %d (%lu)\n", cpu, (unsigned long)GetLastError());
+  }
+#elif defined(__APPLE__)
+  std::fprintf(stderr, "[rt] --cpu %d ignored: no thread affinity on macOS\n", cpu);
+#else
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  const int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  if (err != 0) std::fprintf(stderr, "[rt] cannot pin to CPU %d (%s)\n", cpu, std::strerror(err));
+#endif
+}
+
+// Main thread, once every other thread is running. New threads inherit their
+// creator's policy and affinity, so raising it earlier would put the render,
+// telemetry and file threads at its priority on its spinning CPU.
+static void raiseIoThread(bool realtime, int cpu) {
+  if (realtime) setThreadRealtime("io", 0);
+  if (cpu >= 0) setThreadCpu(cpu);
+}
+
+class TickPacer {
+ public:
+  ~TickPacer() { close(); }
+
+  void open(uint32_t spinUs) {
+    close();
+    spinNs_ = (uint64_t)spinUs * 1000u;
+#ifdef _WIN32
+    timeBeginPeriod(1);
+    period_ = true;
+    timer_ = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    if (!timer_) timer_ = CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+#endif
+  }
+
+  void close() {
+#ifdef _WIN32
+    if (timer_) CloseHandle(timer_);
+    timer_ = nullptr;
+    if (period_) timeEndPeriod(1);
+    period_ = false;
+#endif
+  }
+
+  // Returns nowNs() at wake-up (>= deadlineNs).
+  uint64_t sleepUntil(uint64_t deadlineNs) {
+    uint64_t now = nowNs();
+    if (deadlineNs > now + spinNs_) sleepCoarse(deadlineNs - spinNs_, now);
+    while ((now = nowNs()) < deadlineNs) {
+      // busy-wait the last spinNs_
+    }
+    return now;
+  }
+
+ private:
+  void sleepCoarse(uint64_t untilNs, uint64_t now) {
+#ifdef _WIN32
+    if (timer_) {
+      LARGE_INTEGER due;
+      due.QuadPart = -(LONGLONG)((untilNs - now) / 100u);   // relative, 100 ns units
+      if (SetWaitableTimer(timer_, &due, 0, nullptr, nullptr, FALSE)) {
+        WaitForSingleObject(timer_, INFINITE);
+        return;
+      }
+    }
+    Sleep((DWORD)((untilNs - now) / 1000000u));
+#elif defined(__APPLE__)
+    timespec ts;
+    ts.tv_sec = (time_t)((untilNs - now) / 1000000000u);
+    ts.tv_nsec = (long)((untilNs - now) % 1000000000u);
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {}
+#else
+    (void)now;
+    timespec ts;
+    ts.tv_sec = (time_t)(untilNs / 1000000000u);
+    ts.tv_nsec = (long)(untilNs % 1000000000u);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {}
+#endif
+  }
+
+  uint64_t spinNs_ = 0;
+#ifdef _WIN32
+  HANDLE timer_ = nullptr;
+  bool period_ = false;
+#endif
+};
+
+static TickPacer gPacer;   // I/O thread
+
+// -----------------------------------------------------------------------------
+// Lock-free helpers
+// - SpscRing: bounded single-producer / single-consumer ring. N must be a power
+//   of two. push() fails when full, pop() when empty; neither ever blocks.
+// - TripleBuffer: single-writer / single-reader "latest value" channel. Both
+//   sides are wait-free; the reader always sees a complete, consistent T and
+//   the writer never waits for it (e.g. across a slow glfwSwapBuffers).
+// - PublishSlot: hands immutable heap objects (e.g. a compiled BindPlan) from
+//   any thread to one owner thread, which adopts the newest one when it likes.
+// - atomicMax: relaxed running maximum for counters read by another thread.
+// -----------------------------------------------------------------------------
+template <typename T, uint32_t N>
+class SpscRing {
+  static_assert((N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+ public:
+  bool push(const T& v) {
+    const uint32_t h = head_.load(std::memory_order_relaxed);
+    if (h - tail_.load(std::memory_order_acquire) == N) return false;
+    buf_[h & (N - 1)] = v;
+    head_.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(T& v) {
+    const uint32_t t = tail_.load(std::memory_order_relaxed);
+    if (head_.load(std::memory_order_acquire) == t) return false;
+    v = buf_[t & (N - 1)];
+    tail_.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  uint32_t size() const {
+    return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+  }
+  bool empty() const { return size() == 0; }
+
+ private:
+  T buf_[N];
+  alignas(64) std::atomic<uint32_t> head_{0};
+  alignas(64) std::atomic<uint32_t> tail_{0};
+};
+
+template <typename T>
+class TripleBuffer {
+ public:
+  // Writer: fill writeBuffer() completely (it holds stale data), then publish().
+  T& writeBuffer() { return buf_[back_]; }
+  void publish() {
+    back_ = (uint8_t)(middle_.exchange((uint8_t)(back_ | kFresh)) & kIndex);
+  }
+
+  // Reader: update() swaps in the newest published value, if any, and returns
+  // whether it did. read() stays valid and unchanged until the next update().
+  bool pending() const { return (middle_.load() & kFresh) != 0; }
+  bool update() {
+    if (!pending()) return false;
+    front_ = (uint8_t)(middle_.exchange(front_) & kIndex);
+    return true;
+  }
+  const T& read() const { return buf_[front_]; }
+
+ private:
+  static constexpr uint8_t kIndex = 0x3;
+  static constexpr uint8_t kFresh = 0x4;
+
+  T buf_[3];
+  uint8_t back_ = 0;                      // writer only
+  alignas(64) std::atomic<uint8_t> middle_{1};
+  alignas(64) uint8_t front_ = 2;         // reader only
+};
+
+template <typename T>
+class PublishSlot {
+ public:
+  ~PublishSlot() { delete pending_.exchange(nullptr); }
+
+  // Any thread. A newer submit replaces one the owner has not adopted yet.
+  void submit(std::unique_ptr<T> v) {
+    delete pending_.exchange(v.release(), std::memory_order_acq_rel);
+  }
+
+  // Owner thread: adopt the newest submitted object (the previous one is freed
+  // here, so nothing else may hold a reference to current()).
+  bool acquire() {
+    T* p = pending_.exchange(nullptr, std::memory_order_acq_rel);
+    if (!p) return false;
+    cur_.reset(p);
+    return true;
+  }
+  const T& current() const { return *cur_; }
+
+ private:
+  std::atomic<T*> pending_{nullptr};
+  std::unique_ptr<T> cur_{new T()};
+};
+
+static inline void atomicMax(std::atomic<uint64_t>& a, uint64_t v) {
+  uint64_t cur = a.load(std::memory_order_relaxed);
+  while (v > cur && !a.compare_exchange_weak(cur, v, std::memory_order_relaxed)) {}
+}
+
+
 // -----------------------------------------------------------------------------
 // Input system
 // -----------------------------------------------------------------------------
 static bool gKeyDown[GLFW_KEY_LAST + 1];
 static bool gKeyDownPrev[GLFW_KEY_LAST + 1];
 
+// Packed copy of gKeyDown[] (bit k%64 of word k/64) for the compiled binding plan.
+static constexpr int kKeyWords = (GLFW_KEY_LAST + 1 + 63) / 64;
+static uint64_t gKeyBits[kKeyWords];
+
+// Timestamped key transitions (no repeats), pushed by onKey and drained once per
+// tick by the I/O loop. Both run on the main thread today (onKey fires inside
+// glfwPollEvents); the SPSC ring keeps that an implementation detail.
+struct KeyEvent {
+  uint64_t tNs = 0;
+  int16_t key = 0;
+  uint8_t action = 0;     // GLFW_PRESS / GLFW_RELEASE
+};
+static SpscRing<KeyEvent, 256> gKeyEvents;
+
+// Key presses seen this tick, in order (filled by the I/O loop from gKeyEvents).
+static constexpr int kMaxTickKeyPresses = 16;
+static int gTickKeyPresses[kMaxTickKeyPresses];
+static int gTickKeyPressCount = 0;
+
+// Re-evaluates and writes the pads bound to `key` right away (defined with the
+// I/O loop, once the plan and the writers exist).
+static void onKeyFastPath(int key, uint64_t tNs);
+
 static void onError(int code, const char* desc) {
   std::fprintf(stderr, "[glfw error] code=%d desc=%s\n", code, desc ? desc : "(null)");
 }
@@ -84,8 +785,17 @@ static void onError(int code, const char* desc) {
 static void onKey(GLFWwindow* w, int key, int scancode, int action, int mods) {
   (void)w; (void)scancode; (void)mods;
   if (key >= 0 && key <= GLFW_KEY_LAST) {
-    if (action == GLFW_PRESS) gKeyDown[key] = true;
-    else if (action == GLFW_RELEASE) gKeyDown[key] = false;
+    const uint64_t m = 1ull << (key & 63);
+    if (action == GLFW_PRESS) { gKeyDown[key] = true; gKeyBits[key >> 6] |= m; }
+    else if (action == GLFW_RELEASE) { gKeyDown[key] = false; gKeyBits[key >> 6] &= ~m; }
+    if (action == GLFW_PRESS || action == GLFW_RELEASE) {
+      KeyEvent ev;
+      ev.tNs = nowNs();
+      ev.key = (int16_t)key;
+      ev.action = (uint8_t)action;
+      gKeyEvents.push(ev);   // full: only learning/timestamps lose it, state is already in gKeyBits
+      onKeyFastPath(key, ev.tNs);
+    }
   }
   if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
     glfwSetWindowShouldClose(w, GLFW_TRUE);
@@ -112,113 +822,1035 @@ enum class BindType {
 
 struct Binding {
   BindType type = BindType::None;
-  int jid = -1;        // GLFW joystick id (GLFW_JOYSTICK_1..)
+  int jid = -1;        // GLFW joystick id (GLFW_JOYSTICK_1..); -1 while its device is missing
   int code = -1;       // key code OR button index OR axis index
   int dir = 0;         // for axis dir: -1 or +1
   float threshold = 0.45f;
+  int device = -1;     // gJoyIdents entry (GUID + name) it was learned on, -1 = fixed jid
 
-  std::string toString() const {
-    char buf[256];
+  bool onJoystick() const { return type != BindType::None && type != BindType::Key; }
+
+  // Into a caller buffer (the render thread rebuilds labels without allocating).
+  void format(char* buf, size_t size) const {
+    char at[16];
+    if (jid >= 0) std::snprintf(at, sizeof(at), "jid=%d", jid);
+    else std::snprintf(at, sizeof(at), "offline");
     switch (type) {
       case BindType::None:
-        return "None";
+        std::snprintf(buf, size, "None");
+        return;
       case BindType::Key:
-        std::snprintf(buf, sizeof(buf), "Key(%d)", code);
-        return buf;
+        std::snprintf(buf, size, "Key(%d)", code);
+        return;
       case BindType::GamepadButton:
-        std::snprintf(buf, sizeof(buf), "GP(jid=%d) Btn(%d)", jid, code);
-        return buf;
+        std::snprintf(buf, size, "GP(%s) Btn(%d)", at, code);
+        return;
       case BindType::GamepadAxisDir:
-        std::snprintf(buf, sizeof(buf), "GP(jid=%d) Axis(%d)%s%.2f", jid, code, (dir < 0 ? "<-" : "->"), threshold);
-        return buf;
+        std::snprintf(buf, size, "GP(%s) Axis(%d)%s%.2f", at, code, (dir < 0 ? "<-" : "->"), threshold);
+        return;
       case BindType::JoyButton:
-        std::snprintf(buf, sizeof(buf), "Joy(jid=%d) Btn(%d)", jid, code);
-        return buf;
+        std::snprintf(buf, size, "Joy(%s) Btn(%d)", at, code);
+        return;
       case BindType::JoyAxisDir:
-        std::snprintf(buf, sizeof(buf), "Joy(jid=%d) Axis(%d)%s%.2f", jid, code, (dir < 0 ? "<-" : "->"), threshold);
-        return buf;
+        std::snprintf(buf, size, "Joy(%s) Axis(%d)%s%.2f", at, code, (dir < 0 ? "<-" : "->"), threshold);
+        return;
       default:
-        return "Unknown";
+        std::snprintf(buf, size, "Unknown");
+        return;
     }
   }
 };
 
-static bool sampleBinding(const Binding& b) {
-  if (b.type == BindType::None) return false;
-
-  if (b.type == BindType::Key) {
-    if (b.code < 0 || b.code > GLFW_KEY_LAST) return false;
-    return gKeyDown[b.code];
+// -----------------------------------------------------------------------------
+// Joystick state snapshot (one fetch per present device per tick)
+// - updateJoystickCaches() is the only place that queries GLFW for device state.
+// - Bindings (sampleBinding) and the learning detectors both read gJoy[], so all
+//   pads see the same instant and no device is re-polled per binding.
+// - No heap in steady state: raw buttons/axes live in inline arrays that are
+//   flipped, not copied, each tick, and names are interned once per connect.
+// - Hotplug is incremental: onJoystick (and the native reader's slots) attach
+//   and detach devices in gJoyActive, and per-tick work only walks that list.
+// -----------------------------------------------------------------------------
+static constexpr int kNativeJid0 = GLFW_JOYSTICK_LAST + 1;   // native HID slots follow GLFW's
+static constexpr int kJoyCount = kNativeJid0 + 8;
+static constexpr int kGpButtonSlots = 16;
+static constexpr int kRawButtonSlots = 112;
+static constexpr int kBtnStride = kGpButtonSlots + kRawButtonSlots;
+static constexpr int kGpAxisSlots = 8;
+static constexpr int kRawAxisSlots = 24;
+static constexpr int kAxisStride = kGpAxisSlots + kRawAxisSlots;
+
+// Fixed-capacity inline array, so taking the snapshot never touches the heap.
+template <typename T, int N>
+struct InlineArray {
+  T v[N];
+  int n = 0;
+
+  int size() const { return n; }
+  T operator[](int i) const { return v[i]; }
+  void clear() { n = 0; }
+  // Keeps the first N of count items (the plan cannot address more anyway).
+  void assign(const T* src, int count) {
+    n = src ? (std::max)(0, (std::min)(count, N)) : 0;
+    if (n) std::memcpy(v, src, (size_t)n * sizeof(T));
   }
+};
 
-  if (b.jid < GLFW_JOYSTICK_1 || b.jid > GLFW_JOYSTICK_LAST) return false;
-  if (!glfwJoystickPresent(b.jid)) return false;
+using JoyButtons = InlineArray<unsigned char, kRawButtonSlots>;
+using JoyAxes = InlineArray<float, kRawAxisSlots>;
 
-  if (b.type == BindType::GamepadButton || b.type == BindType::GamepadAxisDir) {
-    if (!glfwJoystickIsGamepad(b.jid)) return false;
-    GLFWgamepadstate st;
-    if (!glfwGetGamepadState(b.jid, &st)) return false;
+struct JoyCache {
+  bool present = false;
+  bool isGamepad = false;   // read on connect
+  char name[128] = {};      // interned on connect, not re-read per tick
+  char guid[33] = {};       // glfwGetJoystickGUID; empty for native devices
 
-    if (b.type == BindType::GamepadButton) {
-      if (b.code < 0 || b.code > GLFW_GAMEPAD_BUTTON_LAST) return false;
-      return st.buttons[b.code] == GLFW_PRESS;
-    } else {
-      if (b.code < 0 || b.code > GLFW_GAMEPAD_AXIS_LAST) return false;
-      float v = st.axes[b.code];
-      if (b.dir < 0) return v < -b.threshold;
-      if (b.dir > 0) return v >  b.threshold;
-      return false;
-    }
-  }
+  // Raw state, double-buffered: flip() turns this tick's cur into prev.
+  JoyButtons btn[2];
+  JoyAxes axis[2];
+  int cur = 0;
 
-  // Raw joystick
-  if (b.type == BindType::JoyButton) {
-    int n = 0;
-    const unsigned char* btn = glfwGetJoystickButtons(b.jid, &n);
-    if (!btn || b.code < 0 || b.code >= n) return false;
-    return btn[b.code] == GLFW_PRESS;
-  }
-  if (b.type == BindType::JoyAxisDir) {
-    int n = 0;
-    const float* ax = glfwGetJoystickAxes(b.jid, &n);
-    if (!ax || b.code < 0 || b.code >= n) return false;
-    float v = ax[b.code];
-    if (b.dir < 0) return v < -b.threshold;
-    if (b.dir > 0) return v >  b.threshold;
-    return false;
+  GLFWgamepadstate gpPrev{};
+  GLFWgamepadstate gpCur{};
+  bool gpHasPrev = false;
+  bool gpHasCur = false;
+
+  const JoyButtons& btnCur() const { return btn[cur]; }
+  const JoyButtons& btnPrev() const { return btn[cur ^ 1]; }
+  const JoyAxes& axisCur() const { return axis[cur]; }
+  const JoyAxes& axisPrev() const { return axis[cur ^ 1]; }
+  void flip() { cur ^= 1; }
+};
+
+static JoyCache gJoy[kJoyCount];
+
+// Fixed-layout copy of the same snapshot for the compiled binding plan.
+// Per jid: [0..kGpButtonSlots) gamepad buttons, then raw buttons; likewise axes.
+// Missing devices / slots read as released buttons and NaN axes (NaN never
+// compares greater than a threshold, so the term stays off).
+static uint8_t gBtnFlat[kJoyCount * kBtnStride];   // 1 = pressed
+static float gAxisFlat[kJoyCount * kAxisStride];
+
+static void flattenJoystick(int jid) {
+  const JoyCache& jc = gJoy[jid];
+  uint8_t* btn = gBtnFlat + jid * kBtnStride;
+  float* ax = gAxisFlat + jid * kAxisStride;
+
+  std::memset(btn, 0, kBtnStride);
+  std::fill(ax, ax + kAxisStride, NAN);
+  if (!jc.present) return;
+
+  if (jc.gpHasCur) {
+    for (int b = 0; b <= GLFW_GAMEPAD_BUTTON_LAST; ++b) btn[b] = jc.gpCur.buttons[b] == GLFW_PRESS;
+    for (int a = 0; a <= GLFW_GAMEPAD_AXIS_LAST; ++a) ax[a] = jc.gpCur.axes[a];
   }
+  const JoyButtons& rb = jc.btnCur();
+  for (int b = 0; b < rb.size(); ++b) btn[kGpButtonSlots + b] = rb[b] == GLFW_PRESS;
+  const JoyAxes& ra = jc.axisCur();
+  for (int a = 0; a < ra.size(); ++a) ax[kGpAxisSlots + a] = ra[a];
+}
 
-  return false;
+static const char* jidName(int jid) {
+  const char* n = glfwGetJoystickName(jid);
+  return n ? n : "(unknown)";
 }
 
-struct Digital6 {
-  bool up = false;
-  bool down = false;
-  bool left = false;
-  bool right = false;
-  bool b1 = false;
-  bool b2 = false;
+// Copies the device name and GUID once per connect (GLFW may build them).
+static void internJoystickName(int jid) {
+  const char* guid = glfwGetJoystickGUID(jid);
+  std::snprintf(gJoy[jid].name, sizeof(gJoy[jid].name), "%s", jidName(jid));
+  std::snprintf(gJoy[jid].guid, sizeof(gJoy[jid].guid), "%s", guid ? guid : "");
+}
 
-  uint8_t packBits() const {
-    // 0=Up,1=Down,2=Left,3=Right,4=B1,5=B2
-    uint8_t v = 0;
-    v |= up    ? (1u << 0) : 0;
-    v |= down  ? (1u << 1) : 0;
-    v |= left  ? (1u << 2) : 0;
-    v |= right ? (1u << 3) : 0;
-    v |= b1    ? (1u << 4) : 0;
-    v |= b2    ? (1u << 5) : 0;
-    return v;
+// One device's state for this tick (GLFW arrays, or synthetic ones from the
+// benchmark). gp == nullptr: not a gamepad / no mapping this tick.
+static void storeJoystickSnapshot(int jid, const unsigned char* btn, int nb, const float* ax, int na,
+                                  const GLFWgamepadstate* gp) {
+  JoyCache& jc = gJoy[jid];
+  jc.flip();
+  jc.btn[jc.cur].assign(btn, nb);
+  jc.axis[jc.cur].assign(ax, na);
+
+  jc.gpPrev = jc.gpCur;
+  jc.gpHasPrev = jc.gpHasCur;
+  jc.gpHasCur = gp != nullptr;
+  if (gp) jc.gpCur = *gp;
+
+  flattenJoystick(jid);
+}
+
+static void clearJoystickCache(int jid) {
+  JoyCache& jc = gJoy[jid];
+  jc.present = false;
+  jc.isGamepad = false;
+  jc.name[0] = '\0';
+  jc.guid[0] = '\0';
+  jc.btn[0].clear();
+  jc.btn[1].clear();
+  jc.axis[0].clear();
+  jc.axis[1].clear();
+  jc.gpHasPrev = false;
+  jc.gpHasCur = false;
+  flattenJoystick(jid);
+}
+
+// Devices attached now, I/O thread. Attach after filling the cache's name,
+// GUID and isGamepad; gJoyListChanged makes the next tick re-resolve bindings.
+static int gJoyActive[kJoyCount];
+static int gJoyActiveCount = 0;
+static bool gJoyListChanged = false;
+
+static void joystickAttached(int jid) {
+  JoyCache& jc = gJoy[jid];
+  if (!jc.present) gJoyActive[gJoyActiveCount++] = jid;
+  jc.present = true;
+  gJoyListChanged = true;
+}
+
+static void joystickDetached(int jid) {
+  if (!gJoy[jid].present) return;
+  for (int i = 0; i < gJoyActiveCount; ++i) {
+    if (gJoyActive[i] != jid) continue;
+    gJoyActive[i] = gJoyActive[--gJoyActiveCount];
+    break;
   }
+  clearJoystickCache(jid);
+  gJoyListChanged = true;
+}
+
+// Device identities bindings were learned on. Entries are never removed, so
+// Binding::device stays valid; GUID and name together tell pad models apart
+// and survive a replug onto another jid (GUIDs alone repeat across vendors).
+struct JoyIdent {
+  char guid[33] = {};
+  char name[128] = {};
 };
 
+static constexpr int kMaxJoyIdents = 64;
+static JoyIdent gJoyIdents[kMaxJoyIdents];
+static int gJoyIdentCount = 0;
+
+// -1 once the table is full: the binding then stays on its jid.
+static int internJoyIdent(const char* guid, const char* name) {
+  for (int i = 0; i < gJoyIdentCount; ++i) {
+    if (std::strcmp(gJoyIdents[i].guid, guid) == 0 && std::strcmp(gJoyIdents[i].name, name) == 0) return i;
+  }
+  if (gJoyIdentCount == kMaxJoyIdents) return -1;
+  JoyIdent& id = gJoyIdents[gJoyIdentCount];
+  std::snprintf(id.guid, sizeof(id.guid), "%s", guid);
+  std::snprintf(id.name, sizeof(id.name), "%s", name);
+  return gJoyIdentCount++;
+}
+
+static bool joystickIs(int jid, int ident) {
+  const JoyCache& jc = gJoy[jid];
+  return jc.present && std::strcmp(jc.guid, gJoyIdents[ident].guid) == 0 &&
+         std::strcmp(jc.name, gJoyIdents[ident].name) == 0;
+}
 
-#if 1
 // -----------------------------------------------------------------------------
-// FT245 bit-bang output (FTDI D2XX)
-// - Outputs 6 bits on D0..D5 (dir mask 0x3F).
-// - We use "active-low" encoding to match the user's examples:
-//     Idle:      111111 (0x3F)
+// Native HID input (--input native)
+// - GLFW only reads joysticks when asked (once per tick here), and on some
+//   platforms each glfwGetJoystick* call re-reads the device, so a 1000 Hz pad
+//   polled at --rate loses most of its reports. A reader thread takes every
+//   report as it arrives, with a timestamp:
+//     Linux:   evdev (/dev/input/event*, kernel CLOCK_MONOTONIC timestamps),
+//              hotplug through inotify on /dev/input
+//     Windows: XInput, polled at 1 kHz on the reader thread (dwPacketNumber
+//              tells new reports)
+//     macOS:   IOHIDManager input value callbacks on the reader's run loop
+// - Devices take the joystick slots after GLFW's (jid kNativeJid0..) and bind
+//   as JoyButton / JoyAxisDir like any raw joystick, so the plan, learning and
+//   padmap.txt need nothing new. Buttons and axes come in GLFW's order for the
+//   same device (hats as up/right/down/left buttons after the buttons).
+// - The reader publishes through atomics. Presses are sticky until the next
+//   tick reads them, so a button down for less than a tick still reaches the
+//   plan (and the press latch).
+// - GLFW joysticks keep working alongside: gamepad mappings, and everything
+//   when the native source cannot start.
+// -----------------------------------------------------------------------------
+static constexpr int kNativeBtnWords = (kRawButtonSlots + 63) / 64;
+
+struct NativePad {
+  // The reader fills name/buttons/axes only while the slot is free, with
+  // connects odd around the fill, then sets present (release). A reader that
+  // saw the same even connects before and after its copy got one occupant.
+  // name/buttons/axes are relaxed atomics: a torn copy is thrown away by the
+  // connects check, but the copy itself must not be a data race.
+  std::atomic<bool> present{false};
+  std::atomic<uint32_t> connects{0};
+  std::atomic<char> name[128] = {};
+  std::atomic<int> buttons{0};
+  std::atomic<int> axes{0};
+
+  std::atomic<uint64_t> down[kNativeBtnWords];
+  std::atomic<uint64_t> pressed[kNativeBtnWords];   // sticky until a tick reads it
+  std::atomic<float> axis[kRawAxisSlots];
+  std::atomic<uint64_t> firstEventNs{0};            // oldest event no tick has seen
+  std::atomic<uint64_t> events{0};
+
+  // Reader thread
+  void setButton(int i, bool on, uint64_t tNs) {
+    if (i < 0 || i >= buttons.load(std::memory_order_relaxed)) return;
+    const uint64_t m = 1ull << (i & 63);
+    if (on) {
+      down[i >> 6].fetch_or(m, std::memory_order_relaxed);
+      pressed[i >> 6].fetch_or(m, std::memory_order_relaxed);
+    } else {
+      down[i >> 6].fetch_and(~m, std::memory_order_relaxed);
+    }
+    touch(tNs);
+  }
+  void setAxis(int i, float v, uint64_t tNs) {
+    if (i < 0 || i >= axes.load(std::memory_order_relaxed)) return;
+    axis[i].store(v, std::memory_order_relaxed);
+    touch(tNs);
+  }
+  // Hat as 4 buttons from base: up, right, down, left.
+  void setHat(int base, int x, int y, uint64_t tNs) {
+    setButton(base + 0, y < 0, tNs);
+    setButton(base + 1, x > 0, tNs);
+    setButton(base + 2, y > 0, tNs);
+    setButton(base + 3, x < 0, tNs);
+  }
+  // Reader thread, only while the slot is being filled.
+  void setName(const char* s) {
+    size_t i = 0;
+    for (; i + 1 < sizeof(name) && s[i]; ++i) name[i].store(s[i], std::memory_order_relaxed);
+    name[i].store('\0', std::memory_order_relaxed);
+  }
+  void copyName(char* out, size_t size) const {
+    size_t i = 0;
+    for (; i + 1 < size && i < sizeof(name); ++i) {
+      out[i] = name[i].load(std::memory_order_relaxed);
+      if (!out[i]) return;
+    }
+    out[i] = '\0';
+  }
+
+  void touch(uint64_t tNs) {
+    uint64_t none = 0;
+    firstEventNs.compare_exchange_strong(none, tNs ? tNs : 1, std::memory_order_relaxed);
+    events.fetch_add(1, std::memory_order_relaxed);
+  }
+};
+
+static constexpr int kNativeSlots = kJoyCount - kNativeJid0;
+static NativePad gNative[kNativeSlots];
+
+enum class InputSource {
+  Glfw = 0,   // GLFW joysticks only
+  Native      // + the platform reader below
+};
+
+class NativeInput {
+ public:
+  ~NativeInput() { stop(); }
+
+  // False if there is no native source here or it cannot start.
+  bool start() {
+    stop_.store(false);
+#if defined(__linux__)
+    if (pipe(wakeFd_) != 0) return false;
+    inotifyFd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd_ >= 0) inotify_add_watch(inotifyFd_, "/dev/input", IN_CREATE | IN_ATTRIB);
+#elif !defined(_WIN32) && !defined(__APPLE__)
+    return false;
+#endif
+    th_ = std::thread(&NativeInput::threadMain, this);
+    running_ = true;
+    return true;
+  }
+
+  void stop() {
+    if (!running_) return;
+    stop_.store(true);
+#if defined(__linux__)
+    const char c = 0;
+    if (write(wakeFd_[1], &c, 1) < 0) {}
+#endif
+    th_.join();
+    running_ = false;
+#if defined(__linux__)
+    close(wakeFd_[0]);
+    close(wakeFd_[1]);
+    if (inotifyFd_ >= 0) close(inotifyFd_);
+    inotifyFd_ = -1;
+#endif
+    for (int s = 0; s < kNativeSlots; ++s) gNative[s].present.store(false, std::memory_order_release);
+  }
+
+  bool running() const { return running_; }
+
+  // I/O thread, once per tick: native slots -> gJoy[] / the flat snapshot.
+  // Returns the oldest event time since the last call (0 = none).
+  uint64_t snapshot() {
+    uint64_t first = 0;
+    for (int s = 0; s < kNativeSlots; ++s) {
+      NativePad& np = gNative[s];
+      const int jid = kNativeJid0 + s;
+      JoyCache& jc = gJoy[jid];
+      if (!np.present.load(std::memory_order_acquire)) {
+        joystickDetached(jid);
+        continue;
+      }
+      const uint32_t c = np.connects.load(std::memory_order_acquire);
+      if (c & 1u) continue;   // being refilled; next tick
+
+      char name[sizeof(np.name)];
+      np.copyName(name, sizeof(name));
+      const int buttons = (std::min)(np.buttons.load(std::memory_order_relaxed), kRawButtonSlots);
+      const int axes = (std::min)(np.axes.load(std::memory_order_relaxed), kRawAxisSlots);
+      unsigned char btn[kRawButtonSlots];
+      float ax[kRawAxisSlots];
+      for (int w = 0; w < kNativeBtnWords; ++w) {
+        const uint64_t bits = np.down[w].load(std::memory_order_relaxed) |
+                              np.pressed[w].exchange(0, std::memory_order_relaxed);
+        for (int b = 0; b < 64 && w * 64 + b < buttons; ++b) {
+          btn[w * 64 + b] = (bits >> b) & 1u ? GLFW_PRESS : GLFW_RELEASE;
+        }
+      }
+      for (int a = 0; a < axes; ++a) ax[a] = np.axis[a].load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (np.connects.load(std::memory_order_relaxed) != c) continue;   // slot reused meanwhile
+
+      if (!jc.present || c != connectsSeen_[s]) {
+        connectsSeen_[s] = c;
+        joystickDetached(jid);   // replaced since the last tick
+        std::snprintf(jc.name, sizeof(jc.name), "%s", name);
+        joystickAttached(jid);
+      }
+      storeJoystickSnapshot(jid, btn, buttons, ax, axes, nullptr);
+
+      const uint64_t t = np.firstEventNs.exchange(0, std::memory_order_relaxed);
+      if (t && (!first || t < first)) first = t;
+    }
+    return first;
+  }
+
+ private:
+  // Reader thread. -1 when all slots are taken.
+  int claimSlot(const char* name, int buttons, int axes) {
+    for (int s = 0; s < kNativeSlots; ++s) {
+      NativePad& np = gNative[s];
+      if (np.present.load(std::memory_order_relaxed)) continue;
+      // Odd while filling: a snapshot() still copying the previous occupant
+      // sees the change and drops its copy.
+      np.connects.fetch_add(1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      np.setName(name);
+      buttons = (std::min)(buttons, kRawButtonSlots);
+      axes = (std::min)(axes, kRawAxisSlots);
+      np.buttons.store(buttons, std::memory_order_relaxed);
+      np.axes.store(axes, std::memory_order_relaxed);
+      for (int w = 0; w < kNativeBtnWords; ++w) {
+        np.down[w].store(0, std::memory_order_relaxed);
+        np.pressed[w].store(0, std::memory_order_relaxed);
+      }
+      for (int a = 0; a < kRawAxisSlots; ++a) np.axis[a].store(0.0f, std::memory_order_relaxed);
+      np.connects.fetch_add(1, std::memory_order_release);
+      np.present.store(true, std::memory_order_release);
+      std::fprintf(stderr, "[hid] CONNECT jid=%d name=%s buttons=%d axes=%d\n",
+        kNativeJid0 + s, name, buttons, axes);
+      return s;
+    }
+    std::fprintf(stderr, "[hid] %s: all %d native slots in use, left to GLFW\n", name, kNativeSlots);
+    return -1;
+  }
+
+  void releaseSlot(int s) {
+    if (s < 0) return;
+    gNative[s].present.store(false, std::memory_order_release);
+    std::fprintf(stderr, "[hid] DISCONNECT jid=%d\n", kNativeJid0 + s);
+  }
+
+  void threadMain() {
+    traceSetThreadName("hid");
+    if (gRealtime) setThreadRealtime("hid", 1);
+#if defined(__linux__)
+    runEvdev();
+#elif defined(_WIN32)
+    runXInput();
+#elif defined(__APPLE__)
+    runIOHID();
+#endif
+  }
+
+#if defined(__linux__)
+  static constexpr size_t kEvdevPathMax = sizeof("/dev/input/") + sizeof(dirent::d_name);
+
+  struct EvdevPad {
+    int fd = -1;
+    int slot = -1;
+    char path[kEvdevPathMax] = {};
+    int16_t keyIndex[KEY_CNT - BTN_MISC];   // evdev code - BTN_MISC -> button (-1 = none)
+    int8_t absIndex[ABS_CNT];               // -> axis, or hat number for ABS_HAT*X
+    input_absinfo absInfo[ABS_CNT];
+    int hatBase = 0;                        // first hat button
+    int hat[4][2] = {};
+    bool dropped = false;                   // SYN_DROPPED seen, frame not ended yet
+  };
+
+  static bool testBit(const unsigned long* bits, int n) {
+    const int w = (int)(sizeof(unsigned long) * 8);
+    return (bits[n / w] >> (n % w)) & 1ul;
+  }
+
+  static uint64_t eventNs(const input_event& ev) {
+#ifdef input_event_sec
+    const uint64_t t = (uint64_t)ev.input_event_sec * 1000000000ull + (uint64_t)ev.input_event_usec * 1000ull;
+#else
+    const uint64_t t = (uint64_t)ev.time.tv_sec * 1000000000ull + (uint64_t)ev.time.tv_usec * 1000ull;
+#endif
+    const uint64_t now = nowNs();
+    return t && t <= now ? t : now;   // EVIOCSCLOCKID refused: wall clock stamps
+  }
+
+  void openEvdev(const char* path) {
+    for (const EvdevPad& p : pads_) if (std::strcmp(p.path, path) == 0) return;
+    const int fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+      if (errno == EACCES && !warnedAccess_) {
+        std::fprintf(stderr, "[hid] %s: permission denied (is the user in the 'input' group?)\n", path);
+        warnedAccess_ = true;
+      }
+      return;
+    }
+
+    const int lw = (int)(sizeof(unsigned long) * 8);
+    unsigned long evBits[(EV_CNT + lw - 1) / lw] = {};
+    unsigned long keyBits[(KEY_CNT + lw - 1) / lw] = {};
+    unsigned long absBits[(ABS_CNT + lw - 1) / lw] = {};
+    bool stick = false;
+    if (ioctl(fd, EVIOCGBIT(0, sizeof(evBits)), evBits) >= 0 &&
+        ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(keyBits)), keyBits) >= 0 &&
+        ioctl(fd, EVIOCGBIT(EV_ABS, sizeof(absBits)), absBits) >= 0 &&
+        testBit(evBits, EV_KEY) && testBit(evBits, EV_ABS)) {
+      // Joystick / gamepad buttons; keeps touchpads and tablets out.
+      for (int c = BTN_JOYSTICK; c <= BTN_THUMBR && !stick; ++c) stick = testBit(keyBits, c);
+    }
+    if (!stick) {
+      close(fd);
+      return;
+    }
+
+    EvdevPad p;
+    p.fd = fd;
+    std::snprintf(p.path, sizeof(p.path), "%s", path);
+    int buttons = 0, axes = 0, hats = 0;
+    for (int c = BTN_MISC; c < KEY_CNT; ++c) {
+      p.keyIndex[c - BTN_MISC] = (int16_t)(testBit(keyBits, c) ? buttons++ : -1);
+    }
+    for (int c = 0; c < ABS_CNT; ++c) {
+      p.absIndex[c] = -1;
+      if (!testBit(absBits, c)) continue;
+      if (c >= ABS_HAT0X && c <= ABS_HAT3Y) {
+        p.absIndex[c] = (int8_t)((c - ABS_HAT0X) / 2);
+        if ((c - ABS_HAT0X) % 2 == 0) ++hats;
+        continue;
+      }
+      if (ioctl(fd, EVIOCGABS(c), &p.absInfo[c]) < 0) continue;
+      p.absIndex[c] = (int8_t)axes++;
+    }
+    p.hatBase = buttons;
+
+    const int clk = CLOCK_MONOTONIC;   // the clock behind nowNs()
+    ioctl(fd, EVIOCSCLOCKID, &clk);
+
+    char name[128] = "(unknown)";
+    ioctl(fd, EVIOCGNAME(sizeof(name)), name);
+    p.slot = claimSlot(name, buttons + 4 * hats, axes);
+    if (p.slot < 0) {
+      close(fd);
+      return;
+    }
+    pads_.push_back(p);
+    resyncEvdev(pads_.back());
+  }
+
+  void scanEvdev() {
+    DIR* d = opendir("/dev/input");
+    if (!d) return;
+    while (dirent* e = readdir(d)) {
+      if (std::strncmp(e->d_name, "event", 5) != 0) continue;
+      char path[kEvdevPathMax];
+      const int n = std::snprintf(path, sizeof(path), "/dev/input/%s", e->d_name);
+      if (n < 0 || (size_t)n >= sizeof(path)) continue;
+      openEvdev(path);
+    }
+    closedir(d);
+  }
+
+  // Startup and SYN_DROPPED: read the whole state back from the kernel.
+  void resyncEvdev(EvdevPad& p) {
+    NativePad& np = gNative[p.slot];
+    const uint64_t t = nowNs();
+    const int lw = (int)(sizeof(unsigned long) * 8);
+    unsigned long keys[(KEY_CNT + lw - 1) / lw] = {};
+    if (ioctl(p.fd, EVIOCGKEY(sizeof(keys)), keys) >= 0) {
+      for (int c = BTN_MISC; c < KEY_CNT; ++c) {
+        if (p.keyIndex[c - BTN_MISC] >= 0) np.setButton(p.keyIndex[c - BTN_MISC], testBit(keys, c), t);
+      }
+    }
+    for (int c = 0; c < ABS_CNT; ++c) {
+      if (p.absIndex[c] < 0) continue;
+      input_absinfo info;
+      if (ioctl(p.fd, EVIOCGABS(c), &info) < 0) continue;
+      applyAbs(p, c, info.value, t);
+    }
+  }
+
+  void applyAbs(EvdevPad& p, int code, int value, uint64_t t) {
+    NativePad& np = gNative[p.slot];
+    const int index = p.absIndex[code];
+    if (index < 0) return;
+    if (code >= ABS_HAT0X && code <= ABS_HAT3Y) {
+      int* h = p.hat[index];
+      h[(code - ABS_HAT0X) % 2] = value < 0 ? -1 : value > 0 ? 1 : 0;
+      np.setHat(p.hatBase + 4 * index, h[0], h[1], t);
+      return;
+    }
+    const input_absinfo& info = p.absInfo[code];
+    float v = (float)value;
+    const int range = info.maximum - info.minimum;
+    if (range) v = (v - (float)info.minimum) / (float)range * 2.0f - 1.0f;
+    np.setAxis(index, v, t);
+  }
+
+  // False once the device is gone.
+  bool readEvdev(EvdevPad& p) {
+    input_event evs[64];
+    for (;;) {
+      const ssize_t n = read(p.fd, evs, sizeof(evs));
+      if (n < 0) return errno == EAGAIN || errno == EINTR;
+      if (n == 0) return false;
+      for (size_t i = 0; i < (size_t)n / sizeof(input_event); ++i) {
+        const input_event& ev = evs[i];
+        if (ev.type == EV_SYN && ev.code == SYN_DROPPED) {
+          p.dropped = true;
+          continue;
+        }
+        if (p.dropped) {
+          // The rest of the broken frame is stale; once it ends, read the
+          // state back and carry on with the frames after it.
+          if (ev.type == EV_SYN && ev.code == SYN_REPORT) {
+            p.dropped = false;
+            resyncEvdev(p);
+          }
+          continue;
+        }
+        if (ev.type == EV_KEY && ev.code >= BTN_MISC && ev.code < KEY_CNT) {
+          gNative[p.slot].setButton(p.keyIndex[ev.code - BTN_MISC], ev.value != 0, eventNs(ev));
+        } else if (ev.type == EV_ABS && ev.code < ABS_CNT) {
+          applyAbs(p, ev.code, ev.value, eventNs(ev));
+        }
+      }
+    }
+  }
+
+  void runEvdev() {
+    scanEvdev();
+    while (!stop_.load()) {
+      pollfd fds[2 + kNativeSlots];
+      int n = 0;
+      fds[n++] = pollfd{wakeFd_[0], POLLIN, 0};
+      if (inotifyFd_ >= 0) fds[n++] = pollfd{inotifyFd_, POLLIN, 0};
+      const int first = n;
+      for (const EvdevPad& p : pads_) fds[n++] = pollfd{p.fd, POLLIN, 0};
+      if (poll(fds, (nfds_t)n, -1) < 0 && errno != EINTR) break;
+      if (stop_.load()) break;
+
+      if (inotifyFd_ >= 0 && (fds[1].revents & POLLIN)) {
+        char buf[4096];
+        while (read(inotifyFd_, buf, sizeof(buf)) > 0) {}
+        scanEvdev();   // appends to pads_; fds[] above still matches the old ones
+      }
+      for (int i = n - 1; i >= first; --i) {
+        if (!fds[i].revents) continue;
+        EvdevPad& p = pads_[(size_t)(i - first)];
+        if ((fds[i].revents & (POLLERR | POLLHUP | POLLNVAL)) || !readEvdev(p)) {
+          close(p.fd);
+          releaseSlot(p.slot);
+          pads_.erase(pads_.begin() + (i - first));
+        }
+      }
+    }
+    for (EvdevPad& p : pads_) {
+      close(p.fd);
+      releaseSlot(p.slot);
+    }
+    pads_.clear();
+  }
+
+  std::vector<EvdevPad> pads_;   // reader thread
+  int wakeFd_[2] = {-1, -1};
+  int inotifyFd_ = -1;
+  bool warnedAccess_ = false;
+#endif
+
+#if defined(_WIN32)
+  void runXInput() {
+    int slot[XUSER_MAX_COUNT];
+    DWORD packet[XUSER_MAX_COUNT] = {};
+    uint64_t probedNs[XUSER_MAX_COUNT] = {};
+    for (int& s : slot) s = -1;
+    // GLFW's XInput order: A B X Y LB RB Back Start LThumb RThumb, then the D-pad hat.
+    static const WORD kButtons[10] = {
+      XINPUT_GAMEPAD_A, XINPUT_GAMEPAD_B, XINPUT_GAMEPAD_X, XINPUT_GAMEPAD_Y,
+      XINPUT_GAMEPAD_LEFT_SHOULDER, XINPUT_GAMEPAD_RIGHT_SHOULDER, XINPUT_GAMEPAD_BACK, XINPUT_GAMEPAD_START,
+      XINPUT_GAMEPAD_LEFT_THUMB, XINPUT_GAMEPAD_RIGHT_THUMB
+    };
+
+    while (!stop_.load()) {
+      const uint64_t now = nowNs();
+      for (DWORD i = 0; i < XUSER_MAX_COUNT; ++i) {
+        // XInputGetState on an empty port is slow; look for new pads once a second.
+        if (slot[i] < 0 && now - probedNs[i] < 1000000000ull) continue;
+        XINPUT_STATE st;
+        if (XInputGetState(i, &st) != ERROR_SUCCESS) {
+          if (slot[i] >= 0) releaseSlot(slot[i]);
+          slot[i] = -1;
+          probedNs[i] = now;
+          continue;
+        }
+        if (slot[i] < 0) {
+          char name[32];
+          std::snprintf(name, sizeof(name), "XInput pad %lu", (unsigned long)i + 1);
+          slot[i] = claimSlot(name, 14, 6);
+          if (slot[i] < 0) {
+            probedNs[i] = now;
+            continue;
+          }
+          packet[i] = st.dwPacketNumber - 1;
+        }
+        if (st.dwPacketNumber == packet[i]) continue;
+        packet[i] = st.dwPacketNumber;
+
+        NativePad& np = gNative[slot[i]];
+        const XINPUT_GAMEPAD& g = st.Gamepad;
+        for (int b = 0; b < 10; ++b) np.setButton(b, (g.wButtons & kButtons[b]) != 0, now);
+        np.setHat(10, (g.wButtons & XINPUT_GAMEPAD_DPAD_RIGHT) ? 1 : (g.wButtons & XINPUT_GAMEPAD_DPAD_LEFT) ? -1 : 0,
+          (g.wButtons & XINPUT_GAMEPAD_DPAD_DOWN) ? 1 : (g.wButtons & XINPUT_GAMEPAD_DPAD_UP) ? -1 : 0, now);
+        np.setAxis(0, (g.sThumbLX + 0.5f) / 32767.5f, now);
+        np.setAxis(1, -(g.sThumbLY + 0.5f) / 32767.5f, now);
+        np.setAxis(2, (g.sThumbRX + 0.5f) / 32767.5f, now);
+        np.setAxis(3, -(g.sThumbRY + 0.5f) / 32767.5f, now);
+        np.setAxis(4, g.bLeftTrigger / 127.5f - 1.0f, now);
+        np.setAxis(5, g.bRightTrigger / 127.5f - 1.0f, now);
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));   // 1 ms with timeBeginPeriod(1)
+    }
+    for (int s : slot) releaseSlot(s);
+  }
+#endif
+
+#if defined(__APPLE__)
+  struct HidPad {
+    IOHIDDeviceRef dev = nullptr;
+    int slot = -1;
+    std::vector<IOHIDElementRef> buttons, axes, hats;   // sorted by usage, like GLFW
+  };
+
+  static void onHidMatch(void* ctx, IOReturn, void*, IOHIDDeviceRef dev) {
+    static_cast<NativeInput*>(ctx)->attachHid(dev);
+  }
+  static void onHidRemove(void* ctx, IOReturn, void*, IOHIDDeviceRef dev) {
+    static_cast<NativeInput*>(ctx)->detachHid(dev);
+  }
+  static void onHidValue(void* ctx, IOReturn, void*, IOHIDValueRef v) {
+    static_cast<NativeInput*>(ctx)->valueHid(v);
+  }
+
+  static void sortByUsage(std::vector<IOHIDElementRef>& v) {
+    std::sort(v.begin(), v.end(), [](IOHIDElementRef a, IOHIDElementRef b) {
+      return IOHIDElementGetUsage(a) < IOHIDElementGetUsage(b);
+    });
+  }
+
+  void attachHid(IOHIDDeviceRef dev) {
+    HidPad p;
+    p.dev = dev;
+    CFArrayRef elements = IOHIDDeviceCopyMatchingElements(dev, nullptr, kIOHIDOptionsTypeNone);
+    if (elements) {
+      for (CFIndex i = 0; i < CFArrayGetCount(elements); ++i) {
+        IOHIDElementRef e = (IOHIDElementRef)CFArrayGetValueAtIndex(elements, i);
+        const IOHIDElementType type = IOHIDElementGetType(e);
+        if (type != kIOHIDElementTypeInput_Misc && type != kIOHIDElementTypeInput_Button &&
+            type != kIOHIDElementTypeInput_Axis) continue;
+        const uint32_t page = IOHIDElementGetUsagePage(e), usage = IOHIDElementGetUsage(e);
+        if (page == kHIDPage_GenericDesktop) {
+          if (usage == kHIDUsage_GD_Hatswitch) p.hats.push_back(e);
+          else if (usage >= kHIDUsage_GD_DPadUp && usage <= kHIDUsage_GD_DPadLeft) p.buttons.push_back(e);
+          else if (usage >= kHIDUsage_GD_X && usage <= kHIDUsage_GD_Wheel) p.axes.push_back(e);
+        } else if (page == kHIDPage_Simulation) {
+          p.axes.push_back(e);
+        } else if (page == kHIDPage_Button || page == kHIDPage_Consumer) {
+          p.buttons.push_back(e);
+        }
+      }
+      CFRelease(elements);
+    }
+    sortByUsage(p.buttons);
+    sortByUsage(p.axes);
+    sortByUsage(p.hats);
+
+    char name[128] = "(unknown)";
+    CFTypeRef product = IOHIDDeviceGetProperty(dev, CFSTR(kIOHIDProductKey));
+    if (product && CFGetTypeID(product) == CFStringGetTypeID()) {
+      CFStringGetCString((CFStringRef)product, name, sizeof(name), kCFStringEncodingUTF8);
+    }
+    p.slot = claimSlot(name, (int)(p.buttons.size() + 4 * p.hats.size()), (int)p.axes.size());
+    if (p.slot >= 0) pads_.push_back(p);
+  }
+
+  void detachHid(IOHIDDeviceRef dev) {
+    for (size_t i = 0; i < pads_.size(); ++i) {
+      if (pads_[i].dev != dev) continue;
+      releaseSlot(pads_[i].slot);
+      pads_.erase(pads_.begin() + (long)i);
+      return;
+    }
+  }
+
+  void valueHid(IOHIDValueRef v) {
+    IOHIDElementRef e = IOHIDValueGetElement(v);
+    IOHIDDeviceRef dev = IOHIDElementGetDevice(e);
+    const uint64_t t = nowNs();
+    const long value = (long)IOHIDValueGetIntegerValue(v);
+    for (HidPad& p : pads_) {
+      if (p.dev != dev) continue;
+      NativePad& np = gNative[p.slot];
+      for (size_t i = 0; i < p.buttons.size(); ++i) {
+        if (p.buttons[i] != e) continue;
+        np.setButton((int)i, value != 0, t);
+        return;
+      }
+      for (size_t i = 0; i < p.axes.size(); ++i) {
+        if (p.axes[i] != e) continue;
+        const long lo = (long)IOHIDElementGetLogicalMin(e), hi = (long)IOHIDElementGetLogicalMax(e);
+        const float f = hi > lo ? (float)(value - lo) / (float)(hi - lo) * 2.0f - 1.0f : 0.0f;
+        np.setAxis((int)i, f, t);
+        return;
+      }
+      for (size_t i = 0; i < p.hats.size(); ++i) {
+        if (p.hats[i] != e) continue;
+        // 0..7 = N, NE, E, SE, S, SW, W, NW; anything else is centered.
+        static const int kX[8] = {0, 1, 1, 1, 0, -1, -1, -1};
+        static const int kY[8] = {-1, -1, 0, 1, 1, 1, 0, -1};
+        long d = value - (long)IOHIDElementGetLogicalMin(e);
+        if (IOHIDElementGetLogicalMax(e) - IOHIDElementGetLogicalMin(e) == 3) d *= 2;   // 4-way hats
+        const bool c = d < 0 || d > 7;
+        np.setHat((int)(p.buttons.size() + 4 * i), c ? 0 : kX[d], c ? 0 : kY[d], t);
+        return;
+      }
+      return;
+    }
+  }
+
+  static CFDictionaryRef hidMatching(uint32_t usage) {
+    const int page = kHIDPage_GenericDesktop;
+    const int u = (int)usage;
+    CFNumberRef pageRef = CFNumberCreate(kCFAllocatorDefault, kCFNumberIntType, &page);
+    CFNumberRef usageRef = CFNumberCreate(kCFAllocatorDefault, kCFNumberIntType, &u);
+    const void* keys[2] = {CFSTR(kIOHIDDeviceUsagePageKey), CFSTR(kIOHIDDeviceUsageKey)};
+    const void* values[2] = {pageRef, usageRef};
+    CFDictionaryRef d = CFDictionaryCreate(kCFAllocatorDefault, keys, values, 2,
+      &kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks);
+    CFRelease(pageRef);
+    CFRelease(usageRef);
+    return d;
+  }
+
+  void runIOHID() {
+    IOHIDManagerRef mgr = IOHIDManagerCreate(kCFAllocatorDefault, kIOHIDOptionsTypeNone);
+    const void* match[3] = {
+      hidMatching(kHIDUsage_GD_Joystick), hidMatching(kHIDUsage_GD_GamePad), hidMatching(kHIDUsage_GD_MultiAxisController)
+    };
+    CFArrayRef matching = CFArrayCreate(kCFAllocatorDefault, match, 3, &kCFTypeArrayCallBacks);
+    for (const void* m : match) CFRelease((CFTypeRef)m);
+    IOHIDManagerSetDeviceMatchingMultiple(mgr, matching);
+    CFRelease(matching);
+
+    IOHIDManagerRegisterDeviceMatchingCallback(mgr, &NativeInput::onHidMatch, this);
+    IOHIDManagerRegisterDeviceRemovalCallback(mgr, &NativeInput::onHidRemove, this);
+    IOHIDManagerRegisterInputValueCallback(mgr, &NativeInput::onHidValue, this);
+    IOHIDManagerScheduleWithRunLoop(mgr, CFRunLoopGetCurrent(), kCFRunLoopDefaultMode);
+    if (IOHIDManagerOpen(mgr, kIOHIDOptionsTypeNone) != kIOReturnSuccess) {
+      std::fprintf(stderr, "[hid] IOHIDManagerOpen failed (Input Monitoring permission?)\n");
+    }
+    // Short slices instead of CFRunLoopStop from stop(): no race with startup.
+    while (!stop_.load()) CFRunLoopRunInMode(kCFRunLoopDefaultMode, 0.1, false);
+
+    IOHIDManagerUnscheduleFromRunLoop(mgr, CFRunLoopGetCurrent(), kCFRunLoopDefaultMode);
+    IOHIDManagerClose(mgr, kIOHIDOptionsTypeNone);
+    CFRelease(mgr);
+    for (HidPad& p : pads_) releaseSlot(p.slot);
+    pads_.clear();
+  }
+
+  std::vector<HidPad> pads_;   // reader thread
+#endif
+
+  std::thread th_;
+  std::atomic<bool> stop_{false};
+  bool running_ = false;
+  uint32_t connectsSeen_[kNativeSlots] = {};   // I/O thread
+};
+
+static NativeInput gNativeInput;
+
+// Attached GLFW joysticks, then the native slots. Returns the oldest native
+// event time since the last call (0 = none).
+static uint64_t updateJoystickCaches() {
+  TRACE_ZONE("updateJoystickCaches");
+  for (int i = 0; i < gJoyActiveCount; ++i) {
+    const int jid = gJoyActive[i];
+    if (jid >= kNativeJid0) continue;   // gNativeInput.snapshot()
+    JoyCache& jc = gJoy[jid];
+
+    int nb = 0, na = 0;
+    const unsigned char* btn = glfwGetJoystickButtons(jid, &nb);
+    const float* ax = glfwGetJoystickAxes(jid, &na);
+
+    GLFWgamepadstate st;
+    const bool gp = jc.isGamepad && glfwGetGamepadState(jid, &st);
+    storeJoystickSnapshot(jid, btn, nb, ax, na, gp ? &st : nullptr);
+  }
+  return gNativeInput.running() ? gNativeInput.snapshot() : 0;
+}
+
+static bool sampleBinding(const Binding& b) {
+  if (b.type == BindType::None) return false;
+
+  if (b.type == BindType::Key) {
+    if (b.code < 0 || b.code > GLFW_KEY_LAST) return false;
+    return gKeyDown[b.code];
+  }
+
+  if (b.jid < GLFW_JOYSTICK_1 || b.jid >= kJoyCount) return false;
+  const JoyCache& jc = gJoy[b.jid];
+  if (!jc.present) return false;
+
+  if (b.type == BindType::GamepadButton || b.type == BindType::GamepadAxisDir) {
+    if (!jc.isGamepad || !jc.gpHasCur) return false;
+    const GLFWgamepadstate& st = jc.gpCur;
+
+    if (b.type == BindType::GamepadButton) {
+      if (b.code < 0 || b.code > GLFW_GAMEPAD_BUTTON_LAST) return false;
+      return st.buttons[b.code] == GLFW_PRESS;
+    } else {
+      if (b.code < 0 || b.code > GLFW_GAMEPAD_AXIS_LAST) return false;
+      float v = st.axes[b.code];
+      if (b.dir < 0) return v < -b.threshold;
+      if (b.dir > 0) return v >  b.threshold;
+      return false;
+    }
+  }
+
+  // Raw joystick
+  if (b.type == BindType::JoyButton) {
+    if (b.code < 0 || b.code >= jc.btnCur().size()) return false;
+    return jc.btnCur()[b.code] == GLFW_PRESS;
+  }
+  if (b.type == BindType::JoyAxisDir) {
+    if (b.code < 0 || b.code >= jc.axisCur().size()) return false;
+    float v = jc.axisCur()[b.code];
+    if (b.dir < 0) return v < -b.threshold;
+    if (b.dir > 0) return v >  b.threshold;
+    return false;
+  }
+
+  return false;
+}
+
+struct Digital6 {
+  bool up = false;
+  bool down = false;
+  bool left = false;
+  bool right = false;
+  bool b1 = false;
+  bool b2 = false;
+
+  uint8_t packBits() const {
+    // 0=Up,1=Down,2=Left,3=Right,4=B1,5=B2
+    uint8_t v = 0;
+    v |= up    ? (1u << 0) : 0;
+    v |= down  ? (1u << 1) : 0;
+    v |= left  ? (1u << 2) : 0;
+    v |= right ? (1u << 3) : 0;
+    v |= b1    ? (1u << 4) : 0;
+    v |= b2    ? (1u << 5) : 0;
+    return v;
+  }
+};
+
+static constexpr int kMaxPads = 8;   // virtual pads the pipeline carries
+
+// -----------------------------------------------------------------------------
+// Press latching (--min-pulse-us)
+// - The target reads the port once per frame, and GLFW only shows joystick
+//   state at poll time, so a tap shorter than a frame can fall between two
+//   reads. Every press the plan sees, from the key fast path (each GLFW key
+//   event) or from a tick's snapshot, stays on the output for at least the
+//   minimum pulse width: one target frame by default (the locked --vsync
+//   period, else --macro-frame-us).
+// - A release inside that window is deferred to the first tick after it. A
+//   new press of a bit that is still held restarts the window, so overlapping
+//   taps merge into one pulse and one write.
+// - Main thread only (onKey fires inside glfwPollEvents).
+// -----------------------------------------------------------------------------
+class PressLatch {
+ public:
+  void setMinPulseNs(uint64_t ns) { minNs_ = ns; }
+  uint64_t minPulseNs() const { return minNs_; }
+
+  // bits6: active-low plan output for pads [0, n), holds applied in place.
+  void apply(uint8_t* bits6, int n, uint64_t tNs) {
+    for (int p = 0; p < n; ++p) {
+      const uint8_t live = (uint8_t)(~bits6[p] & 0x3Fu);
+      const uint8_t rose = (uint8_t)(live & ~live_[p]);
+      uint8_t held = 0;
+      for (int b = 0; b < 6; ++b) {
+        const uint8_t m = (uint8_t)(1u << b);
+        if (rose & m) {
+          if (out_[p] & m) ++merged_;
+          untilNs_[p][b] = tNs + minNs_;
+        } else if (!(live & m) && tNs < untilNs_[p][b]) {
+          held |= m;
+        }
+      }
+      if (held & ~held_[p]) ++stretched_;
+      held_[p] = held;
+      live_[p] = live;
+      out_[p] = (uint8_t)(live | held);
+      bits6[p] = (uint8_t)(bits6[p] & ~held);
+    }
+  }
+
+  uint64_t stretched() const { return stretched_; }   // releases deferred
+  uint64_t merged() const { return merged_; }         // presses inside a held pulse
+
+ private:
+  uint64_t minNs_ = 0;
+  uint8_t live_[kMaxPads] = {};      // active-high plan output last call
+  uint8_t held_[kMaxPads] = {};      // released but still held
+  uint8_t out_[kMaxPads] = {};       // active-high latched output last call
+  uint64_t untilNs_[kMaxPads][6] = {};
+  uint64_t stretched_ = 0;
+  uint64_t merged_ = 0;
+};
+
+static PressLatch gPressLatch;
+static int gMinPulseUs = -1;   // --min-pulse-us (-1 = one target frame)
+
+
+
+#if 1
+// -----------------------------------------------------------------------------
+// FT245 bit-bang output (FTDI D2XX)
+// - Outputs 6 bits on D0..D5 (dir mask 0x3F).
+// - We use "active-low" encoding to match the user's examples:
+//     Idle:      111111 (0x3F)
 //     Up:        111110 (clear D0)
 //     Down:      111101 (clear D1)
 //     Left:      111011 (clear D2)
@@ -228,8 +1860,11 @@ struct Digital6 {
 //
 // If your hardware expects active-high, invert the bits before writing.
 // -----------------------------------------------------------------------------
+static std::atomic<uint64_t> gFtErrors{0};   // failed D2XX calls, any thread (telemetry)
+
 static bool ftOk(FT_STATUS st, const char* what) {
   if (st == FT_OK) return true;
+  gFtErrors.fetch_add(1, std::memory_order_relaxed);
   std::fprintf(stderr, "[ft245] %s failed: %d\n", what, (int)st);
 return false;
 }
@@ -253,9 +1888,55 @@ static uint8_t packBits6ActiveLow(const Digital6& d) {
   return v;
 }
 
+// Pin layouts:
+// - Single: D0..D5 = one pad (VPad1). D6/D7 unused (inputs).
+// - Mux2:   both pads time-multiplexed on D0..D5 in one FT_Write per tick.
+//           D6 = pad select (0 = VPad1, 1 = VPad2), D7 = strobe. The adapter
+//           latches D0..D5 into the pad selected by D6 on the D7 rising edge:
+//             [D7=0 D6=0 pad1] [D7=1 D6=0 pad1] [D7=0 D6=1 pad2] [D7=1 D6=1 pad2]
+//           Both pads therefore update in the same USB transaction.
+// - Probe:  all pins inputs (loopback test probe).
+enum class Ft245Layout {
+  Single = 0,
+  Mux2,
+  Probe
+};
+
+static int ft245LayoutPads(Ft245Layout layout) {
+  switch (layout) {
+    case Ft245Layout::Mux2: return 2;
+    case Ft245Layout::Probe: return 0;
+    default: return 1;
+  }
+}
+
+static const char* ft245LayoutName(Ft245Layout layout) {
+  switch (layout) {
+    case Ft245Layout::Mux2: return "mux";
+    case Ft245Layout::Probe: return "probe";
+    default: return "single";
+  }
+}
+
+static UCHAR ft245DirMask(Ft245Layout layout) {
+  switch (layout) {
+    case Ft245Layout::Mux2: return 0xFF;
+    case Ft245Layout::Probe: return 0x00;
+    default: return 0x3F;
+  }
+}
+
+// USB transfer settings of an FT245 (see tuneFt245). The defaults are what
+// open() always used.
+struct FtdiTuning {
+  UCHAR latencyMs = 2;       // FT_SetLatencyTimer: RX flush timeout
+  ULONG usbInSize = 4096;    // FT_SetUSBParameters: USB transfer size (driver default)
+  ULONG baud = 115200;       // bit-bang clock, kBitBangBaudFactor bytes/s per baud
+};
+
 class Ft245BitBang {
  public:
-  bool open(int index) {
+  bool open(int index, Ft245Layout layout = Ft245Layout::Single) {
     close();
 
     FT_HANDLE h = nullptr;
@@ -265,64 +1946,1685 @@ class Ft245BitBang {
 return false;
     }
 
-    h_ = h;
+    return configure(h, layout);
+  }
 
-    ftOk(FT_ResetDevice(h_), "FT_ResetDevice");
-    ftOk(FT_Purge(h_, FT_PURGE_RX | FT_PURGE_TX), "FT_Purge");
-    ftOk(FT_SetBaudRate(h_, 115200), "FT_SetBaudRate");
-    ftOk(FT_SetLatencyTimer(h_, 2), "FT_SetLatencyTimer");
+  bool openBySerial(const char* serial, Ft245Layout layout = Ft245Layout::Single) {
+    close();
 
-    // D0..D5 outputs
-    const UCHAR dir_mask = 0x3F;
-    st = FT_SetBitMode(h_, dir_mask, 0x01); // 0x01 = async bit-bang
-    if (!ftOk(st, "FT_SetBitMode(ASYNC_BITBANG)")) {
-      close();
+    FT_HANDLE h = nullptr;
+    FT_STATUS st = FT_OpenEx((PVOID)serial, FT_OPEN_BY_SERIAL_NUMBER, &h);
+    if (st != FT_OK || !h) {
+      std::fprintf(stderr, "[ft245] FT_OpenEx(%s) failed: %d\n", serial, (int)st);
       return false;
     }
-
-    // Set idle (111111)
-    last_ = 0xFFu;
-    writeBits6(0x3Fu, /*force=*/true);
-    return true;
+
+    return configure(h, layout);
+  }
+
+  void close() {
+    if (!h_) return;
+
+    // Try to restore safe idle and disable bit-bang.
+    writeIdle();
+    FT_SetBitMode(h_, 0x00, 0x00);
+    FT_Close(h_);
+    h_ = nullptr;
+    last_ = 0xFFu;
+    lastPair_ = 0xFFFFu;
+  }
+
+  bool isOpen() const { return h_ != nullptr; }
+  uint8_t lastBits() const { return last_; }
+
+  // Latency timer, USB transfer size and bit-bang clock; any time while open.
+  bool applyTuning(const FtdiTuning& t) {
+    if (!h_) return false;
+    bool ok = ftOk(FT_SetLatencyTimer(h_, t.latencyMs), "FT_SetLatencyTimer");
+    ok = ftOk(FT_SetUSBParameters(h_, t.usbInSize, t.usbInSize), "FT_SetUSBParameters") && ok;
+    ok = ftOk(FT_SetBaudRate(h_, t.baud), "FT_SetBaudRate") && ok;
+    return ok;
+  }
+
+  // Raw bytes of the sample on the pins now (idle if not known), for
+  // measurements that must not move them.
+  int currentSample(UCHAR* out) const {
+    uint8_t bits6[2] = {0x3Fu, 0x3Fu};
+    if (layout_ == Ft245Layout::Mux2) {
+      if (lastPair_ != 0xFFFFu) {
+        bits6[0] = (uint8_t)(lastPair_ & 0x3Fu);
+        bits6[1] = (uint8_t)((lastPair_ >> 8) & 0x3Fu);
+      }
+    } else if (last_ != 0xFFu) {
+      bits6[0] = last_;
+    }
+    return renderSample(bits6, out);
+  }
+
+  Ft245Layout layout() const { return layout_; }
+
+  // Number of virtual pads this layout carries (VPad1..).
+  int padCount() const { return ft245LayoutPads(layout_); }
+
+  // True if writePads() would actually write (some carried pad changed).
+  bool needsWrite(const uint8_t* bits6) const {
+    if (layout_ == Ft245Layout::Mux2) return pair(bits6[0], bits6[1]) != lastPair_;
+    return (uint8_t)(bits6[0] & 0x3Fu) != last_;
+  }
+
+  // Writes bits6[0..padCount()) in one FT_Write.
+  bool writePads(const uint8_t* bits6, bool force = false) {
+    if (layout_ != Ft245Layout::Mux2) return writeBits6(bits6[0], force);
+    return writeMux2(bits6[0], bits6[1], force);
+  }
+
+  // Loopback test support.
+  // 0x01 = async bit-bang (normal output), 0x04 = synchronous bit-bang, where
+  // every byte written also samples the pins into the RX buffer.
+  bool setBitMode(UCHAR mode) {
+    if (!h_) return false;
+    if (!ftOk(FT_SetBitMode(h_, dir_, mode), "FT_SetBitMode")) return false;
+    ftOk(FT_Purge(h_, FT_PURGE_RX | FT_PURGE_TX), "FT_Purge");
+    last_ = 0xFFu;
+    return true;
+  }
+
+  // Raw bytes per output sample: a Mux2 sample is the 4-byte select/latch frame.
+  int bytesPerSample() const { return layout_ == Ft245Layout::Mux2 ? 4 : 1; }
+
+  // Renders one output sample (bits6 per carried pad) as raw pin bytes.
+  int renderSample(const uint8_t* bits6, UCHAR* out) const {
+    if (layout_ != Ft245Layout::Mux2) {
+      out[0] = (UCHAR)(bits6[0] & 0x3Fu);
+      return 1;
+    }
+    muxFrame(bits6[0], bits6[1], out);
+    return 4;
+  }
+
+  // Waveform streaming support (see OutputWriter::runStream).
+  // FT232R/FT245R clock bit-bang bytes at kBitBangBaudFactor x the programmed
+  // baud rate (AN_232R-01).
+  static constexpr uint32_t kBitBangBaudFactor = 16;
+
+  bool setByteRate(uint32_t bytesPerSec) {
+    if (!h_) return false;
+    ULONG baud = (ULONG)(std::max)(bytesPerSec / kBitBangBaudFactor, 300u);
+    return ftOk(FT_SetBaudRate(h_, baud), "FT_SetBaudRate");
+  }
+
+  bool writeRaw(const UCHAR* data, DWORD n) {
+    if (!h_) return false;
+    DWORD written = 0;
+    FT_STATUS st = FT_Write(h_, (LPVOID)data, n, &written);
+    if (st != FT_OK || written != n) {
+      std::fprintf(stderr, "[ft245] FT_Write(stream) failed: st=%d written=%lu\n", (int)st, (unsigned long)written);
+      return false;
+    }
+    last_ = 0xFFu;
+    lastPair_ = 0xFFFFu;
+    return true;
+  }
+
+  // Synchronous bit-bang returns one pin sample per byte clocked out; reading
+  // them both keeps the chip running and tells us how far it has got.
+  // Returns the number of bytes consumed, or -1 on error.
+  long drainReadBack() {
+    if (!h_) return -1;
+    long total = 0;
+    for (;;) {
+      DWORD q = 0;
+      if (FT_GetQueueStatus(h_, &q) != FT_OK) return -1;
+      if (q == 0) return total;
+      UCHAR buf[512];
+      DWORD want = (std::min)(q, (DWORD)sizeof(buf));
+      DWORD got = 0;
+      if (FT_Read(h_, buf, want, &got) != FT_OK) return -1;
+      total += (long)got;
+      if (got < want) return total;
+    }
+  }
+
+  // Bytes waiting in the chip's RX / TX buffers (FT_GetStatus).
+  bool queueStatus(DWORD& rx, DWORD& tx) const {
+    if (!h_) return false;
+    DWORD events = 0;
+    return FT_GetStatus(h_, &rx, &tx, &events) == FT_OK;
+  }
+
+  // Instantaneous pin state (FT_GetBitMode), independent of the bit-bang FIFO.
+  bool readPins(uint8_t& pins) {
+    if (!h_) return false;
+    UCHAR v = 0;
+    if (FT_GetBitMode(h_, &v) != FT_OK) return false;
+    pins = (uint8_t)v;
+    return true;
+  }
+
+  // Synchronous bit-bang: write n bytes and read back the n pin samples.
+  // Sample i is taken just before byte i is driven, so the effect of byte i is
+  // visible in sample i + 1.
+  bool transferSync(const uint8_t* out, uint8_t* in, DWORD n) {
+    if (!h_) return false;
+    DWORD done = 0;
+    FT_STATUS st = FT_Write(h_, (LPVOID)out, n, &done);
+    if (st != FT_OK || done != n) return false;
+    DWORD got = 0;
+    while (got < n) {
+      DWORD r = 0;
+      st = FT_Read(h_, in + got, n - got, &r);
+      if (st != FT_OK || r == 0) return false;
+      got += r;
+    }
+    last_ = (uint8_t)(out[n - 1] & 0x3Fu);
+    return true;
+  }
+
+  bool writeBits6(uint8_t bits6, bool force = false) {
+    if (!h_) return false;
+
+    bits6 = (uint8_t)(bits6 & 0x3Fu);
+    if (!force && bits6 == last_) return true;
+
+    UCHAR out = (UCHAR)bits6;
+    DWORD written = 0;
+    FT_STATUS st = FT_Write(h_, &out, 1, &written);
+    if (st != FT_OK || written != 1) {
+      std::fprintf(stderr, "[ft245] FT_Write failed: st=%d written=%lu\n", (int)st, (unsigned long)written);
+      return false;
+    }
+
+    last_ = bits6;
+    return true;
+  }
+
+ private:
+  bool configure(FT_HANDLE h, Ft245Layout layout) {
+    h_ = h;
+
+    ftOk(FT_ResetDevice(h_), "FT_ResetDevice");
+    ftOk(FT_Purge(h_, FT_PURGE_RX | FT_PURGE_TX), "FT_Purge");
+    applyTuning(FtdiTuning());
+    // Bounded transfers: a stalled device fails the write (and the writer
+    // reconnects) instead of hanging the thread.
+    ftOk(FT_SetTimeouts(h_, kReadTimeoutMs, kWriteTimeoutMs), "FT_SetTimeouts");
+
+    // D0..D5 outputs (+ D6/D7 for Mux2)
+    layout_ = layout;
+    dir_ = ft245DirMask(layout);
+    FT_STATUS st = FT_SetBitMode(h_, dir_, 0x01); // 0x01 = async bit-bang
+    if (!ftOk(st, "FT_SetBitMode(ASYNC_BITBANG)")) {
+      close();
+      return false;
+    }
+
+    // Set idle (111111)
+    last_ = 0xFFu;
+    lastPair_ = 0xFFFFu;
+    writeIdle();
+    return true;
+  }
+
+  static uint16_t pair(uint8_t a, uint8_t b) {
+    return (uint16_t)((a & 0x3Fu) | ((b & 0x3Fu) << 8));
+  }
+
+  void writeIdle() {
+    const uint8_t idle[2] = {0x3Fu, 0x3Fu};
+    writePads(idle, /*force=*/true);
+  }
+
+  static void muxFrame(uint8_t a, uint8_t b, UCHAR frame[4]) {
+    a = (uint8_t)(a & 0x3Fu);
+    b = (uint8_t)(b & 0x3Fu);
+    frame[0] = (UCHAR)(a | 0x00);   // pad1: D6=0, strobe D7 low -> high
+    frame[1] = (UCHAR)(a | 0x80);
+    frame[2] = (UCHAR)(b | 0x40);   // pad2: D6=1, strobe D7 low -> high
+    frame[3] = (UCHAR)(b | 0xC0);
+  }
+
+  bool writeMux2(uint8_t a, uint8_t b, bool force) {
+    if (!h_) return false;
+
+    const uint16_t p = pair(a, b);
+    if (!force && p == lastPair_) return true;
+
+    UCHAR frame[4];
+    muxFrame(a, b, frame);
+    DWORD written = 0;
+    FT_STATUS st = FT_Write(h_, (LPVOID)frame, 4, &written);
+    if (st != FT_OK || written != 4) {
+      std::fprintf(stderr, "[ft245] FT_Write(mux) failed: st=%d written=%lu\n", (int)st, (unsigned long)written);
+      return false;
+    }
+
+    lastPair_ = p;
+    last_ = (uint8_t)(a & 0x3Fu);
+    return true;
+  }
+
+  static constexpr ULONG kReadTimeoutMs = 100;
+  static constexpr ULONG kWriteTimeoutMs = 500;
+
+  FT_HANDLE h_ = nullptr;
+  uint8_t last_ = 0xFFu;
+  uint16_t lastPair_ = 0xFFFFu;
+  Ft245Layout layout_ = Ft245Layout::Single;
+  UCHAR dir_ = 0x3F;
+};
+
+
+// -----------------------------------------------------------------------------
+// FTDI transfer tuning (--ftdi-tune auto|force|off, F6, ftdi_tune.txt)
+// - The best latency timer, USB transfer size and bit-bang clock depend on the
+//   host controller and hubs. An FT245 output without a stored profile for its
+//   serial is measured at open, on its writer thread: each candidate gets
+//   kTuneTrips synchronous bit-bang round trips (FT_Write -> FT_Read through the
+//   same chip, as --latency-test), or FT_Write completion times where sync
+//   bit-bang is not available. Every trip re-sends the sample already on the
+//   pins, so the target sees no change.
+// - Sweep: latency timer x transfer size at the default clock, then the other
+//   clocks with the best of those; 11 candidates. A read-back only returns
+//   when the latency timer fires, so the timer values bound the pause: up to
+//   (kTuneTrips + 1) x 3 x (1 + 2 + 4) ms + 2 x (kTuneTrips + 1) x 4 ms, about
+//   1.4 s of no output on the first open of a serial. Longer timers are left
+//   out: they can't win on latency and would multiply that.
+// - Score = p50 + 2 x (p99 - p50), i.e. latency with jitter counted double.
+// - Profiles are kept per serial in ftdi_tune.txt (written via rename) and
+//   applied at every later open. A serial is swept at most once per run (force
+//   included), so a reconnect after a failed sweep or save opens with the
+//   defaults instead of pausing again. F6 sweeps at once (direct-write outputs
+//   only; output pauses while it runs).
+// -----------------------------------------------------------------------------
+enum class FtdiTuneMode { Off, Auto, Force };
+
+static FtdiTuneMode gFtdiTuneMode = FtdiTuneMode::Off;   // Off until startOutputWriters() applies --ftdi-tune
+static const char* kTuneFile = "ftdi_tune.txt";
+
+static const UCHAR kTuneLatencyMs[] = {1, 2, 4};
+static const ULONG kTuneUsbSizes[] = {64, 512, 4096};
+static const ULONG kTuneBauds[] = {57600, 115200, 187500};
+static constexpr int kTuneTrips = 48;
+
+struct FtdiProfile {
+  std::string serial;
+  FtdiTuning t;
+  double p50Us = 0.0;
+  double p99Us = 0.0;
+};
+
+static bool writeFileReplacing(const char* path, const std::string& text);
+
+static double tuneScoreUs(const LatencyHistogram& h) {
+  const double p50 = (double)h.percentile(0.50) / 1000.0;
+  const double p99 = (double)h.percentile(0.99) / 1000.0;
+  return p50 + 2.0 * (p99 - p50);
+}
+
+// kTuneTrips timed transfers of sample with t applied; the first one after the
+// change is not counted. False if t can't be applied or a transfer fails.
+static bool measureFtdiTuning(Ft245BitBang& dev, const FtdiTuning& t, bool sync,
+                              const UCHAR* sample, int n, LatencyHistogram& h) {
+  if (!dev.applyTuning(t)) return false;
+  uint8_t in[4];
+  for (int i = 0; i <= kTuneTrips; ++i) {
+    const uint64_t t0 = nowNs();
+    const bool ok = sync ? dev.transferSync(sample, in, (DWORD)n) : dev.writeRaw(sample, (DWORD)n);
+    if (!ok) {
+      dev.setBitMode(sync ? 0x04 : 0x01);   // purge what is left of the trip
+      return false;
+    }
+    if (i > 0) h.record(nowNs() - t0);
+  }
+  return true;
+}
+
+// Writer thread, device open in async bit-bang. Leaves the winner applied (the
+// defaults if nothing could be measured) and async bit-bang restored.
+static bool tuneFt245(Ft245BitBang& dev, const char* serial, FtdiProfile& p) {
+  UCHAR sample[4];
+  const int n = dev.currentSample(sample);
+  const bool sync = dev.setBitMode(0x04);
+  const uint64_t t0 = nowNs();
+  std::fprintf(stderr, "[tune] %s: measuring %s\n", serial, sync ? "read-back round trips" : "write completion");
+
+  bool found = false;
+  double bestScore = 0.0;
+  int candidates = 0;
+  auto consider = [&](const FtdiTuning& t) {
+    LatencyHistogram h;
+    ++candidates;
+    if (!measureFtdiTuning(dev, t, sync, sample, n, h)) return;
+    const double score = tuneScoreUs(h);
+    if (found && score >= bestScore) return;
+    found = true;
+    bestScore = score;
+    p.t = t;
+    p.p50Us = (double)h.percentile(0.50) / 1000.0;
+    p.p99Us = (double)h.percentile(0.99) / 1000.0;
+  };
+  for (UCHAR latencyMs : kTuneLatencyMs) {
+    for (ULONG usbInSize : kTuneUsbSizes) {
+      FtdiTuning t;
+      t.latencyMs = latencyMs;
+      t.usbInSize = usbInSize;
+      consider(t);
+    }
+  }
+  if (found) {
+    const FtdiTuning base = p.t;
+    for (ULONG baud : kTuneBauds) {
+      if (baud == base.baud) continue;
+      FtdiTuning t = base;
+      t.baud = baud;
+      consider(t);
+    }
+  }
+
+  if (sync) dev.setBitMode(0x01);
+  dev.applyTuning(found ? p.t : FtdiTuning());
+  if (!found) {
+    std::fprintf(stderr, "[tune] %s: no candidate could be measured, using the defaults\n", serial);
+    return false;
+  }
+  std::fprintf(stderr, "[tune] %s: latency %u ms, usb %lu B, baud %lu -> p50 %.0f us, p99 %.0f us (%d candidates, %.1f s)\n",
+    serial, (unsigned)p.t.latencyMs, (unsigned long)p.t.usbInSize, (unsigned long)p.t.baud,
+    p.p50Us, p.p99Us, candidates, (double)(nowNs() - t0) / 1e9);
+  return true;
+}
+
+class FtdiProfiles {
+ public:
+  // Startup, before the writers. A missing file is no error.
+  void load(const char* path) {
+    std::lock_guard<std::mutex> lock(m_);
+    list_.clear();
+    std::FILE* fp = std::fopen(path, "rb");
+    if (!fp) return;
+    char line[256];
+    int lineNo = 0;
+    while (std::fgets(line, sizeof(line), fp)) {
+      ++lineNo;
+      if (line[0] == '#' || line[0] == '\n' || line[0] == '\r') continue;
+      char serial[64];
+      unsigned latencyMs = 0;
+      unsigned long usbInSize = 0, baud = 0;
+      FtdiProfile p;
+      if (std::sscanf(line, "%63s %u %lu %lu %lf %lf", serial, &latencyMs, &usbInSize, &baud, &p.p50Us, &p.p99Us) != 6 ||
+          latencyMs < 1 || latencyMs > 255 || usbInSize < 64 || usbInSize > 65536 || usbInSize % 64 || baud < 300) {
+        std::fprintf(stderr, "[tune] %s:%d: bad profile, ignored\n", path, lineNo);
+        continue;
+      }
+      p.serial = serial;
+      p.t.latencyMs = (UCHAR)latencyMs;
+      p.t.usbInSize = (ULONG)usbInSize;
+      p.t.baud = (ULONG)baud;
+      list_.push_back(p);
+    }
+    std::fclose(fp);
+    std::fprintf(stderr, "[tune] %zu profile%s from %s\n", list_.size(), list_.size() == 1 ? "" : "s", path);
+  }
+
+  // Writer thread, right after open (open() applied the defaults). retune:
+  // measure now whatever the mode says.
+  void apply(Ft245BitBang& dev, const std::string& serial, bool retune) {
+    if (gFtdiTuneMode == FtdiTuneMode::Off && !retune) return;
+    FtdiProfile p;
+    bool known = false;
+    bool measure = retune;
+    {
+      std::lock_guard<std::mutex> lock(m_);
+      for (const FtdiProfile& q : list_) {
+        if (q.serial != serial) continue;
+        p = q;
+        known = true;
+      }
+      const bool attempted = std::find(attempted_.begin(), attempted_.end(), serial) != attempted_.end();
+      if (!attempted && (!known || gFtdiTuneMode == FtdiTuneMode::Force)) measure = true;
+      if (measure && !attempted) attempted_.push_back(serial);
+    }
+    if (!measure && !known) {
+      std::fprintf(stderr, "[tune] %s: already swept this run, using the defaults\n", serial.c_str());
+      return;
+    }
+    if (!measure) {
+      dev.applyTuning(p.t);
+      std::fprintf(stderr, "[tune] %s: latency %u ms, usb %lu B, baud %lu (stored, p99 %.0f us)\n",
+        serial.c_str(), (unsigned)p.t.latencyMs, (unsigned long)p.t.usbInSize, (unsigned long)p.t.baud, p.p99Us);
+      return;
+    }
+
+    // One device at a time: sweeps on a shared hub would skew each other.
+    bool ok;
+    {
+      std::lock_guard<std::mutex> tuneLock(tuneM_);
+      ok = tuneFt245(dev, serial.c_str(), p);
+    }
+    if (!ok) {
+      if (known) dev.applyTuning(p.t);
+      return;
+    }
+    p.serial = serial;
+
+    std::lock_guard<std::mutex> lock(m_);
+    bool replaced = false;
+    for (FtdiProfile& q : list_) {
+      if (q.serial != serial) continue;
+      q = p;
+      replaced = true;
+    }
+    if (!replaced) list_.push_back(p);
+    if (!writeFileReplacing(kTuneFile, format())) {
+      std::fprintf(stderr, "[tune] saving %s failed\n", kTuneFile);
+    }
+  }
+
+ private:
+  // With m_ held.
+  std::string format() const {
+    std::string text = "# usb2atari FTDI tuning: serial latency_ms usb_bytes baud p50_us p99_us\n";
+    char line[160];
+    for (const FtdiProfile& p : list_) {
+      std::snprintf(line, sizeof(line), "%s %u %lu %lu %.0f %.0f\n", p.serial.c_str(),
+        (unsigned)p.t.latencyMs, (unsigned long)p.t.usbInSize, (unsigned long)p.t.baud, p.p50Us, p.p99Us);
+      text += line;
+    }
+    return text;
+  }
+
+  std::mutex m_;       // list_, attempted_
+  std::mutex tuneM_;   // one sweep at a time
+  std::vector<FtdiProfile> list_;
+  std::vector<std::string> attempted_;   // serials swept (or tried) this run
+};
+
+static FtdiProfiles gFtdiProfiles;
+
+// -----------------------------------------------------------------------------
+// Hardware loopback latency test (--latency-test N)
+// - Without a probe: the output device is switched to synchronous bit-bang and
+//   each round trip writes a pattern and reads the pins back through the same
+//   chip (FT_Write -> FT_Read).
+// - With --probe INDEX: a second FTDI device, all pins inputs, is wired to
+//   D0..D5 of the output device. Each round trip writes the pattern in async
+//   bit-bang and polls the probe's pins (FT_GetBitMode) until it shows up.
+// - Both measure host -> pin -> host, i.e. an upper bound on host -> pin.
+// -----------------------------------------------------------------------------
+static int runLatencyTest(int deviceIndex, int probeIndex, int iterations) {
+  Ft245BitBang out;
+  if (!out.open(deviceIndex)) {
+    std::fprintf(stderr, "[loop] cannot open output device %d\n", deviceIndex);
+    return 1;
+  }
+
+  Ft245BitBang probe;
+  const bool useProbe = probeIndex >= 0;
+  if (useProbe) {
+    if (!probe.open(probeIndex, Ft245Layout::Probe)) {
+      std::fprintf(stderr, "[loop] cannot open probe device %d\n", probeIndex);
+      return 1;
+    }
+  } else if (!out.setBitMode(0x04)) {
+    std::fprintf(stderr, "[loop] synchronous bit-bang not available\n");
+    return 1;
+  }
+
+  std::fprintf(stderr, "[loop] %d round trips, output=%d %s\n", iterations, deviceIndex,
+    useProbe ? "probe" : "sync bit-bang read-back");
+  if (useProbe) std::fprintf(stderr, "[loop] probe=%d\n", probeIndex);
+
+  // Walk each line low in turn, alternating with idle, so every iteration
+  // changes at least one pin.
+  static const uint8_t kPattern[] = {0x3E, 0x3F, 0x3D, 0x3F, 0x3B, 0x3F, 0x37, 0x3F, 0x2F, 0x3F, 0x1F, 0x3F};
+  const int kPatternLen = (int)(sizeof(kPattern) / sizeof(kPattern[0]));
+  const uint64_t kTimeoutNs = 100ull * 1000 * 1000;
+
+  LatencyHistogram hist;
+  uint64_t sumNs = 0, minNs = ~0ull;
+  int failures = 0, mismatches = 0;
+
+  for (int i = 0; i < iterations; ++i) {
+    const uint8_t pat = kPattern[i % kPatternLen];
+    uint64_t t0 = nowNs(), t1 = 0;
+    bool ok = false;
+
+    if (useProbe) {
+      if (out.writeBits6(pat, /*force=*/true)) {
+        uint8_t pins = 0;
+        while (nowNs() - t0 < kTimeoutNs) {
+          if (!probe.readPins(pins)) break;
+          if ((pins & 0x3Fu) == pat) { ok = true; break; }
+        }
+        t1 = nowNs();
+        if (!ok) ++mismatches;
+      }
+    } else {
+      uint8_t tx[2] = {pat, pat};
+      uint8_t rx[2] = {0, 0};
+      if (out.transferSync(tx, rx, 2)) {
+        t1 = nowNs();
+        ok = (rx[1] & 0x3Fu) == pat;
+        if (!ok) ++mismatches;
+      }
+    }
+
+    if (!t1) { ++failures; continue; }
+    if (!ok) continue;
+
+    uint64_t dt = t1 - t0;
+    hist.record(dt);
+    sumNs += dt;
+    if (dt < minNs) minNs = dt;
+  }
+
+  if (!useProbe) out.setBitMode(0x01);
+  out.close();
+  probe.close();
+
+  std::fprintf(stderr, "[loop] ok=%llu usb_failures=%d pattern_mismatch=%d\n",
+    (unsigned long long)hist.count, failures, mismatches);
+  if (hist.count) {
+    std::fprintf(stderr,
+      "[loop] round trip (us): min=%.1f mean=%.1f p50=%.1f p90=%.1f p99=%.1f p99.9=%.1f max=%.1f\n",
+      (double)minNs / 1000.0,
+      (double)sumNs / (double)hist.count / 1000.0,
+      (double)hist.percentile(0.50) / 1000.0,
+      (double)hist.percentile(0.90) / 1000.0,
+      (double)hist.percentile(0.99) / 1000.0,
+      (double)hist.percentile(0.999) / 1000.0,
+      (double)hist.maxNs / 1000.0);
+  }
+  return (hist.count && !failures && !mismatches) ? 0 : 1;
+}
+
+// -----------------------------------------------------------------------------
+// FT245 device enumeration (FT_CreateDeviceInfoList / FT_GetDeviceInfoDetail)
+// -----------------------------------------------------------------------------
+struct Ft245DeviceInfo {
+  std::string serial;
+  std::string description;
+  unsigned long locId = 0;
+  bool opened = false;     // held by another process; serial not readable
+};
+
+static std::vector<Ft245DeviceInfo> enumerateFt245Devices() {
+  std::vector<Ft245DeviceInfo> out;
+  DWORD n = 0;
+  if (!ftOk(FT_CreateDeviceInfoList(&n), "FT_CreateDeviceInfoList")) return out;
+
+  for (DWORD i = 0; i < n; ++i) {
+    DWORD flags = 0, type = 0, id = 0, loc = 0;
+    char serial[16] = {};
+    char desc[64] = {};
+    FT_HANDLE h = nullptr;
+    if (FT_GetDeviceInfoDetail(i, &flags, &type, &id, &loc, serial, desc, &h) != FT_OK) continue;
+
+    Ft245DeviceInfo d;
+    d.serial = serial;
+    d.description = desc;
+    d.locId = (unsigned long)loc;
+    d.opened = (flags & FT_FLAGS_OPENED) != 0;
+    out.push_back(d);
+  }
+  return out;
+}
+
+// -----------------------------------------------------------------------------
+// Turbo / macro waveforms
+// - Turbo: while the live state holds the button, the output toggles it at hz
+//   (pressed first, 50% duty), phase anchored at the press.
+// - Macro: a trigger key plays a fixed sequence of pad states, each held for a
+//   number of target frames (--macro-frame-us), OR'ed with the live state.
+// - A device carrying a pad with turbo or macros streams its output: its
+//   writer renders 1 ms chunks at --bitbang-rate samples/s and the FT245 clocks
+//   them out in synchronous bit-bang, so edge timing comes from the chip's
+//   clock, not from the host scheduler. Other devices keep direct writes.
+// - Configured at startup only; read-only afterwards.
+// -----------------------------------------------------------------------------
+struct TurboSpec {
+  int pad = 0;
+  uint8_t bit = 0;         // active-high mask (1 << VKey)
+  float hz = 15.0f;
+};
+
+struct MacroStep {
+  uint8_t bits = 0;        // active-high pressed mask
+  int frames = 1;
+};
+
+struct MacroSpec {
+  int key = -1;            // GLFW key code that starts the macro
+  int pad = 0;
+  std::vector<MacroStep> steps;
+};
+
+static std::vector<TurboSpec> gTurbo;
+static std::vector<MacroSpec> gMacros;
+static uint32_t gBitBangRate = 8000;     // streamed samples per second
+static uint32_t gMacroFrameUs = 16683;   // one target frame (59.94 Hz)
+
+// "U D L R 1 2" (also "B1"/"B2") -> active-high bit mask; "-" is neutral.
+static bool parsePadButtons(const char* s, size_t n, uint8_t& out) {
+  out = 0;
+  for (size_t i = 0; i < n; ++i) {
+    switch (s[i]) {
+      case 'U': case 'u': out |= 1u << 0; break;
+      case 'D': case 'd': out |= 1u << 1; break;
+      case 'L': case 'l': out |= 1u << 2; break;
+      case 'R': case 'r': out |= 1u << 3; break;
+      case '1': out |= 1u << 4; break;
+      case '2': out |= 1u << 5; break;
+      case 'B': case 'b': case '+': case '-': break;
+      default: return false;
+    }
+  }
+  return true;
+}
+
+// PAD:BUTTON:HZ, e.g. "1:B1:15"
+static bool parseTurboSpec(const char* s, TurboSpec& t) {
+  int pad = 0;
+  char btn[8] = {};
+  float hz = 0.0f;
+  if (std::sscanf(s, "%d:%7[^:]:%f", &pad, btn, &hz) != 3) return false;
+  uint8_t bits = 0;
+  if (!parsePadButtons(btn, std::strlen(btn), bits) || bits == 0 || (bits & (bits - 1))) return false;
+  if (pad < 1 || hz <= 0.0f) return false;
+  t.pad = pad - 1;
+  t.bit = bits;
+  t.hz = hz;
+  return true;
+}
+
+// KEY:PAD:STEP,STEP,...  with STEP = BUTTONS*FRAMES, e.g. "75:1:D*1,DR*1,R*1,1*2"
+static bool parseMacroSpec(const char* s, MacroSpec& m) {
+  int key = 0, pad = 0, used = 0;
+  if (std::sscanf(s, "%d:%d:%n", &key, &pad, &used) != 2 || used == 0) return false;
+  if (key < 0 || key > GLFW_KEY_LAST || pad < 1) return false;
+  m.key = key;
+  m.pad = pad - 1;
+  m.steps.clear();
+
+  const char* p = s + used;
+  while (*p) {
+    const char* end = std::strchr(p, ',');
+    size_t len = end ? (size_t)(end - p) : std::strlen(p);
+    const char* star = (const char*)std::memchr(p, '*', len);
+    MacroStep st;
+    size_t blen = star ? (size_t)(star - p) : len;
+    if (!parsePadButtons(p, blen, st.bits)) return false;
+    st.frames = star ? std::atoi(star + 1) : 1;
+    if (st.frames < 1) return false;
+    m.steps.push_back(st);
+    p += len;
+    if (*p == ',') ++p;
+  }
+  return !m.steps.empty();
+}
+
+// -----------------------------------------------------------------------------
+// Output backends
+// - A target is one place pad states go to: an FT245 in async bit-bang
+//   (single/mux), an FTDI chip in UART mode with the framed protocol below
+//   (uart), a sink that writes nothing (null: measures the host side alone) or
+//   a remote usb2atari over UDP (--udp-send, see "Network transport").
+// - Each target gets its own backend instance, owned and called only by its
+//   writer thread (below), so backends need no locking. The writer does the
+//   timing and counting, so every transport reports the same stats rows.
+// -----------------------------------------------------------------------------
+enum class OutputKind {
+  Ft245 = 0,
+  Uart,
+  Null,
+  Udp
+};
+
+struct OutputTarget {
+  OutputKind kind = OutputKind::Ft245;
+  std::string serial;      // FTDI serial number (HOST:PORT for Udp)
+  Ft245Layout layout = Ft245Layout::Single;   // Ft245 only
+  int pads = 2;            // Udp only: pads per datagram
+  int firstPad = 0;        // VPad index of the first pad this target carries
+};
+
+static int outputTargetPads(const OutputTarget& t) {
+  switch (t.kind) {
+    case OutputKind::Ft245: return ft245LayoutPads(t.layout);
+    case OutputKind::Udp: return t.pads;
+    default: return 2;
+  }
+}
+
+static const char* outputTargetMode(const OutputTarget& t) {
+  switch (t.kind) {
+    case OutputKind::Uart: return "uart";
+    case OutputKind::Null: return "null";
+    case OutputKind::Udp: return "udp";
+    default: return ft245LayoutName(t.layout);
+  }
+}
+
+class OutputBackend {
+ public:
+  virtual ~OutputBackend() {}
+
+  virtual bool open(const OutputTarget& t) = 0;
+  virtual void close() = 0;
+
+  // True if writePads() would put anything on the wire.
+  virtual bool needsWrite(const uint8_t* bits6) const = 0;
+
+  // bits6[0..outputTargetPads()) in one transfer. Returns the bytes sent, or
+  // -1 on error.
+  virtual int writePads(const uint8_t* bits6) = 0;
+
+  // Called after every writer wake-up, at most pollMs() apart (resends,
+  // keepalives). Returns the bytes sent, or -1 on error.
+  virtual int poll(uint64_t tNs) { (void)tNs; return 0; }
+  virtual int pollMs() const { return 50; }
+
+  // Non-null if the target can stream turbo/macro waveforms.
+  virtual Ft245BitBang* bitBang() { return nullptr; }
+
+  // Bytes queued in the device (RX, TX), where the transport has such a thing.
+  virtual bool queueStatus(uint32_t& rx, uint32_t& tx) { (void)rx; (void)tx; return false; }
+
+  // Instantaneous pin levels, for targets with input pins (VSYNC lock).
+  virtual bool readPins(uint8_t& pins) { (void)pins; return false; }
+
+  // Measure the transfer settings again (FTDI bit-bang targets only).
+  virtual void retune() {}
+};
+
+class Ft245Backend : public OutputBackend {
+ public:
+  bool open(const OutputTarget& t) override {
+    if (!dev_.openBySerial(t.serial.c_str(), t.layout)) return false;
+    serial_ = t.serial;
+    gFtdiProfiles.apply(dev_, serial_, false);
+    return true;
+  }
+  void close() override { dev_.close(); }
+  void retune() override { gFtdiProfiles.apply(dev_, serial_, true); }
+  bool needsWrite(const uint8_t* bits6) const override { return dev_.needsWrite(bits6); }
+  int writePads(const uint8_t* bits6) override { return dev_.writePads(bits6) ? dev_.bytesPerSample() : -1; }
+  Ft245BitBang* bitBang() override { return &dev_; }
+  bool readPins(uint8_t& pins) override { return dev_.readPins(pins); }
+  bool queueStatus(uint32_t& rx, uint32_t& tx) override {
+    DWORD r = 0, t = 0;
+    if (!dev_.queueStatus(r, t)) return false;
+    rx = (uint32_t)r;
+    tx = (uint32_t)t;
+    return true;
+  }
+
+ private:
+  Ft245BitBang dev_;
+  std::string serial_;   // as opened
+};
+
+class NullBackend : public OutputBackend {
+ public:
+  bool open(const OutputTarget& t) override { (void)t; return true; }
+  void close() override {}
+  bool needsWrite(const uint8_t* bits6) const override { (void)bits6; return true; }
+  int writePads(const uint8_t* bits6) override { (void)bits6; return 0; }
+};
+
+// -----------------------------------------------------------------------------
+// UART framed output (mode "uart")
+// - The chip stays in its normal UART/FIFO mode (bit-bang off) at --uart-baud,
+//   8N1, no flow control, and carries two pads per frame:
+//     byte A: 1 P a5 a4 a3 a2 a1 a0    pad 1, bit 7 = frame sync
+//     byte B: 0 P b5 b4 b3 b2 b1 b0    pad 2, only right after an A byte
+//   a/b are the same active-low bits as in bit-bang; P is even parity over
+//   bits 0..5, so the adapter drops a corrupted byte and resyncs on the next A.
+// - A frame is A alone when only pad 1 changed, else A B. At 1 Mbaud a 2-byte
+//   frame spends 20 us on the wire.
+// - On an FT232R the frame leaves on TXD; on an FT245R the same bytes come out
+//   of the parallel FIFO (D0..D7, RXF#/RD# handshake).
+// -----------------------------------------------------------------------------
+static uint32_t gUartBaud = 1000000;
+
+static UCHAR uartFrameByte(uint8_t bits6, bool sync) {
+  const uint8_t v = (uint8_t)(bits6 & 0x3Fu);
+  uint8_t p = v;
+  p ^= (uint8_t)(p >> 4);
+  p ^= (uint8_t)(p >> 2);
+  p ^= (uint8_t)(p >> 1);
+  return (UCHAR)((sync ? 0x80u : 0x00u) | ((p & 1u) << 6) | v);
+}
+
+class UartBackend : public OutputBackend {
+ public:
+  ~UartBackend() override { close(); }
+
+  bool open(const OutputTarget& t) override {
+    close();
+    FT_STATUS st = FT_OpenEx((PVOID)t.serial.c_str(), FT_OPEN_BY_SERIAL_NUMBER, &h_);
+    if (st != FT_OK || !h_) {
+      std::fprintf(stderr, "[uart] FT_OpenEx(%s) failed: %d\n", t.serial.c_str(), (int)st);
+      h_ = nullptr;
+      return false;
+    }
+
+    ftOk(FT_ResetDevice(h_), "FT_ResetDevice");
+    ftOk(FT_SetBitMode(h_, 0x00, 0x00), "FT_SetBitMode(RESET)");
+    ftOk(FT_Purge(h_, FT_PURGE_RX | FT_PURGE_TX), "FT_Purge");
+    ftOk(FT_SetDataCharacteristics(h_, FT_BITS_8, FT_STOP_BITS_1, FT_PARITY_NONE), "FT_SetDataCharacteristics");
+    ftOk(FT_SetFlowControl(h_, FT_FLOW_NONE, 0, 0), "FT_SetFlowControl");
+    ftOk(FT_SetLatencyTimer(h_, 2), "FT_SetLatencyTimer");
+    if (!ftOk(FT_SetBaudRate(h_, gUartBaud), "FT_SetBaudRate")) {
+      FT_Close(h_);
+      h_ = nullptr;
+      return false;
+    }
+
+    writeIdle();
+    return true;
+  }
+
+  void close() override {
+    if (!h_) return;
+    writeIdle();
+    FT_Close(h_);
+    h_ = nullptr;
+  }
+
+  bool needsWrite(const uint8_t* bits6) const override {
+    return (uint8_t)(bits6[0] & 0x3Fu) != last_[0] || (uint8_t)(bits6[1] & 0x3Fu) != last_[1];
+  }
+
+  int writePads(const uint8_t* bits6) override {
+    if (!h_) return -1;
+    UCHAR frame[2];
+    DWORD n = 0;
+    frame[n++] = uartFrameByte(bits6[0], true);
+    if ((uint8_t)(bits6[1] & 0x3Fu) != last_[1]) frame[n++] = uartFrameByte(bits6[1], false);
+
+    DWORD written = 0;
+    FT_STATUS st = FT_Write(h_, (LPVOID)frame, n, &written);
+    if (st != FT_OK || written != n) {
+      std::fprintf(stderr, "[uart] FT_Write failed: st=%d written=%lu\n", (int)st, (unsigned long)written);
+      return -1;
+    }
+    last_[0] = (uint8_t)(bits6[0] & 0x3Fu);
+    last_[1] = (uint8_t)(bits6[1] & 0x3Fu);
+    return (int)n;
+  }
+
+  bool queueStatus(uint32_t& rx, uint32_t& tx) override {
+    if (!h_) return false;
+    DWORD r = 0, t = 0, events = 0;
+    if (FT_GetStatus(h_, &r, &t, &events) != FT_OK) return false;
+    rx = (uint32_t)r;
+    tx = (uint32_t)t;
+    return true;
+  }
+
+ private:
+  void writeIdle() {
+    const uint8_t idle[2] = {0x3Fu, 0x3Fu};
+    last_[0] = last_[1] = 0xFFu;   // full frame
+    writePads(idle);
+  }
+
+  FT_HANDLE h_ = nullptr;
+  uint8_t last_[2] = {0xFFu, 0xFFu};
+};
+
+// -----------------------------------------------------------------------------
+// Target VSYNC phase lock (--vsync D6|D7)
+// - MSX / X68000 games read the joystick port once per frame at a fixed point
+//   after VSYNC, so a free-running host cadence is always out of phase with
+//   it. On a single-layout FT245 D6/D7 are inputs: wire the target's VSYNC (or
+//   the port strobe) to one of them and that device's writer polls the pins
+//   (FT_GetBitMode) every kPollUs while idle.
+// - An edge is timestamped between the midpoints of the two polls around it;
+//   a simple PLL tracks the frame period (EMA) and phase. Locked after
+//   kLockEdges edges within 10% of the prediction; unlocked after 4 periods
+//   without one (cable off, target reset).
+// - While locked the I/O loop moves one tick per target frame to
+//   edge + --vsync-offset-us - --vsync-lead-us, so sampling and the write land
+//   just before the game reads the port.
+// - Each poll is a USB round trip (~0.1-1 ms); the PLL averages that jitter
+//   down, and --vsync-lead-us has to cover what is left plus the write.
+// -----------------------------------------------------------------------------
+struct VsyncEstimate {
+  bool locked = false;
+  uint64_t anchorNs = 0;    // a (smoothed) edge time
+  double periodNs = 0.0;
+};
+
+class VsyncTracker {
+ public:
+  static constexpr uint32_t kPollUs = 250;
+  static constexpr int kLockEdges = 8;
+
+  void configure(uint8_t mask, bool rising) {
+    mask_ = mask;
+    rising_ = rising;
+  }
+  bool enabled() const { return mask_ != 0; }
+  uint8_t mask() const { return mask_; }
+
+  // Writer thread: pin sample taken somewhere in [tBefore, tAfter].
+  void onSample(uint8_t pins, uint64_t tBefore, uint64_t tAfter) {
+    const bool level = (pins & mask_) != 0;
+    const uint64_t mid = tBefore + (tAfter - tBefore) / 2;
+    const uint64_t prevMid = prevMid_;
+    const bool edge = prevMid_ && level != level_ && level == rising_;
+    level_ = level;
+    prevMid_ = mid;
+    if (!edge) {
+      if (est_.locked && (double)(tAfter - lastEdgeNs_) > 4.0 * est_.periodNs) {
+        est_.locked = false;
+        good_ = 0;
+        publish();
+        std::fprintf(stderr, "[vsync] lost (no edge for 4 frames)\n");
+      }
+      return;
+    }
+
+    const uint64_t tEdge = prevMid + (mid - prevMid) / 2;
+    edges_.fetch_add(1, std::memory_order_relaxed);
+    const uint64_t lastEdge = lastEdgeNs_;
+    lastEdgeNs_ = tEdge;
+    if (!lastEdge) return;
+
+    // 33..100 Hz covers 50/60 Hz MSX and the X68000's 55 Hz / 61 Hz modes.
+    const double interval = (double)(tEdge - lastEdge);
+    if (interval < 10e6 || interval > 30e6) {
+      good_ = 0;
+      return;
+    }
+    if (est_.periodNs == 0.0) {
+      est_.periodNs = interval;
+      est_.anchorNs = tEdge;
+      return;
+    }
+
+    const double k = std::floor((double)(tEdge - est_.anchorNs) / est_.periodNs + 0.5);
+    const double predicted = (double)est_.anchorNs + k * est_.periodNs;
+    const double err = (double)tEdge - predicted;
+    if (std::fabs(err) > 0.1 * est_.periodNs || std::fabs(interval - est_.periodNs) > 0.1 * est_.periodNs) {
+      // Phase or rate jumped (mode change, glitch): start over from this edge.
+      good_ = 0;
+      est_.periodNs = interval;
+      est_.anchorNs = tEdge;
+      if (est_.locked) std::fprintf(stderr, "[vsync] lost (phase jump)\n");
+      est_.locked = false;
+      publish();
+      return;
+    }
+    est_.periodNs += (interval - est_.periodNs) / 16.0;
+    est_.anchorNs = (uint64_t)(predicted + err / 4.0);
+    errNs_.store((uint64_t)std::fabs(err), std::memory_order_relaxed);
+    if (!est_.locked && ++good_ >= kLockEdges) {
+      est_.locked = true;
+      std::fprintf(stderr, "[vsync] locked: %.3f Hz\n", 1e9 / est_.periodNs);
+    }
+    publish();
+  }
+
+  // I/O thread: the first sample time >= after that is offsetNs past an edge,
+  // or 0 while unlocked.
+  uint64_t nextSampleAfter(uint64_t after, int64_t offsetNs) {
+    estimates_.update();
+    const VsyncEstimate& e = estimates_.read();
+    if (!e.locked) return 0;
+    const double base = (double)e.anchorNs + (double)offsetNs;
+    const double k = std::ceil(((double)after - base) / e.periodNs);
+    return (uint64_t)(base + k * e.periodNs);
+  }
+
+  // Any thread (stats): 0 while unlocked.
+  double lockedHz() const {
+    const double hz = hz_.load(std::memory_order_relaxed);
+    return hz;
+  }
+  uint64_t edges() const { return edges_.load(std::memory_order_relaxed); }
+  double lastErrUs() const { return (double)errNs_.load(std::memory_order_relaxed) / 1000.0; }
+
+ private:
+  void publish() {
+    estimates_.writeBuffer() = est_;
+    estimates_.publish();
+    hz_.store(est_.locked ? 1e9 / est_.periodNs : 0.0, std::memory_order_relaxed);
+  }
+
+  uint8_t mask_ = 0;
+  bool rising_ = false;
+
+  // Writer thread only
+  bool level_ = false;
+  uint64_t prevMid_ = 0;
+  uint64_t lastEdgeNs_ = 0;
+  int good_ = 0;
+  VsyncEstimate est_;
+
+  TripleBuffer<VsyncEstimate> estimates_;   // writer -> I/O thread
+  std::atomic<double> hz_{0.0};
+  std::atomic<uint64_t> edges_{0};
+  std::atomic<uint64_t> errNs_{0};
+};
+
+static VsyncTracker gVsync;
+static int64_t gVsyncSampleOffsetNs = -1500000;   // --vsync-offset-us - --vsync-lead-us
+static uint64_t gVsyncAlignedTicks = 0;           // I/O thread
+
+// -----------------------------------------------------------------------------
+// Per-target writer threads
+// - Each output target gets its own thread and backend, so a slow or stuck USB
+//   device (or network) only delays its own pads.
+// - The I/O loop feeds it through a bounded lock-free SPSC queue. submit()
+//   never blocks: a state that does not fit is staged and retried on the next
+//   tick (a newer state replaces it -> "dropped"). The writer drains everything
+//   queued and writes only the newest entry ("coalesced" counts the rest).
+// - The only lock the I/O thread can touch is the wake-up mutex, and only while
+//   the writer is idle in its wait (never across a backend write).
+// - Write duration, input->pin latency and bytes sent are recorded by the
+//   writer itself, the same way for every backend.
+// - Devices with turbo/macros run runStream() instead (see above): the loop
+//   keeps ~3 ms of rendered samples queued in the chip and counts underruns.
+// - The writer opens its backend itself, so startup never waits for USB.
+//   While the device is missing it re-enumerates with exponential backoff
+//   (kRetryMinMs..kRetryMaxMs); kLostAfterFailures write errors in a row
+//   (cable pulled) close it and start over. States submitted meanwhile are
+//   drained and only the newest is kept; it goes out right after reconnect.
+// - Target serial kAnyDevice picks the first free FTDI device at each open.
+// -----------------------------------------------------------------------------
+struct OutputRequest {
+  OutputRequest() { std::memset(bits6, 0x3F, sizeof(bits6)); }
+  uint8_t bits6[kMaxPads];
+  uint64_t tInputNs = 0;   // oldest input this state answers
+};
+
+struct OutputWriterCounters {
+  uint64_t submitted = 0;  // requests that entered the queue
+  uint64_t written = 0;    // backend writes that succeeded
+  uint64_t bytes = 0;      // bytes those writes (and resends) put on the wire
+  uint64_t coalesced = 0;  // queued requests superseded before being written
+  uint64_t dropped = 0;    // staged requests replaced while the queue was full
+  uint64_t failures = 0;   // backend write errors
+  uint64_t underruns = 0;  // streaming only: chip FIFO ran dry
+  uint64_t reconnects = 0; // opens after the first one
+  bool connected = false;
+  uint32_t depth = 0;      // current queue depth
+  uint32_t maxDepth = 0;
+  bool queueKnown = false; // device queue sampled (FT_GetStatus), ~every 100 ms
+  uint32_t rxQueue = 0;
+  uint32_t txQueue = 0;
+  bool streaming = false;
+  double measuredRate = 0.0;  // streaming only: samples/s the chip actually clocked
+  double seconds = 0.0;    // since start()
+};
+
+static const char* const kAnyDevice = "auto";
+
+// Serial to open for `want` right now: `want` itself if it is plugged in
+// (kAnyDevice: the first free device), else empty.
+static std::string findFtdiSerial(const std::string& want) {
+  for (const Ft245DeviceInfo& d : enumerateFt245Devices()) {
+    if (d.opened || d.serial.empty()) continue;
+    if (want == kAnyDevice || d.serial == want) return d.serial;
+  }
+  return std::string();
+}
+
+class OutputWriter {
+ public:
+  static constexpr uint32_t kQueueDepth = 8;
+  static constexpr uint32_t kMacroQueueDepth = 16;
+  static constexpr uint32_t kRetryMinMs = 100;
+  static constexpr uint32_t kRetryMaxMs = 5000;
+  static constexpr int kLostAfterFailures = 3;
+
+  ~OutputWriter() { stop(); }
+
+  // Binds target and backend; streaming() is known from here on.
+  void prepare(const OutputTarget& t, std::unique_ptr<OutputBackend> backend) {
+    backend_ = std::move(backend);
+    target_ = t;
+    startNs_ = nowNs();
+    stop_.store(false);
+    staged_ = false;
+    std::memset(submitted_, 0x3F, sizeof(submitted_));
+    std::memset(latest_, 0x3F, sizeof(latest_));
+
+    std::memset(turboHz_, 0, sizeof(turboHz_));
+    macroIds_.clear();
+    streaming_ = false;
+    for (const TurboSpec& ts : gTurbo) {
+      if (!backend_->bitBang()) break;
+      int local = ts.pad - t.firstPad;
+      if (local < 0 || local >= padCount()) continue;
+      for (int b = 0; b < 6; ++b) if (ts.bit & (1u << b)) turboHz_[local][b] = ts.hz;
+      streaming_ = true;
+    }
+    for (size_t i = 0; i < gMacros.size() && backend_->bitBang(); ++i) {
+      int local = gMacros[i].pad - t.firstPad;
+      if (local < 0 || local >= padCount()) continue;
+      macroIds_.push_back((uint8_t)i);
+      streaming_ = true;
+    }
+  }
+
+  // After prepare(). Returns at once; the writer thread opens the backend (see
+  // connect()).
+  void start() {
+    th_ = std::thread(&OutputWriter::threadMain, this);
+  }
+
+  // Restores idle and closes the device (from the writer thread).
+  void stop() {
+    stop_.store(true);
+    wake();
+    if (th_.joinable()) th_.join();
+  }
+
+  const OutputTarget& target() const { return target_; }
+  int padCount() const { return outputTargetPads(target_); }
+  bool streaming() const { return streaming_; }
+
+  // Before start(), with gVsync configured: this writer also polls the pins.
+  void setVsyncSource(bool on) { vsync_ = on; }
+  bool connected() const { return connected_.load(std::memory_order_relaxed); }
+
+  // Any thread. Re-measures the FTDI transfer settings when the writer is next
+  // idle; streaming writers keep theirs (the stream can't pause).
+  void requestRetune() {
+    if (target_.kind != OutputKind::Ft245) return;
+    if (streaming_) {
+      std::fprintf(stderr, "[tune] %s: streaming, not retuned\n", target_.serial.c_str());
+      return;
+    }
+    retune_.store(true);
+    wake();
+  }
+
+  // I/O thread. Starts macro gMacros[id] if it drives one of our pads.
+  void triggerMacro(uint8_t id) {
+    if (std::find(macroIds_.begin(), macroIds_.end(), id) == macroIds_.end()) return;
+    if (!macroQueue_.push(id)) dropped_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // I/O thread. allBits6 is indexed by VPad; tInput is when the input that may
+  // have caused this state was seen. Call every tick so a staged state that
+  // did not fit into the queue gets retried.
+  void submit(const uint8_t* allBits6, uint64_t tInput) {
+    const uint8_t* mine = allBits6 + target_.firstPad;
+    const size_t n = (size_t)padCount();
+    if (std::memcmp(submitted_, mine, n) != 0) {
+      std::memcpy(submitted_, mine, n);
+      if (staged_) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+      } else {
+        stagedReq_.tInputNs = tInput;
+      }
+      std::memcpy(stagedReq_.bits6, mine, n);
+      staged_ = true;
+    }
+    if (!staged_) return;
+
+    if (!queue_.push(stagedReq_)) return;  // full: retry next tick
+    staged_ = false;
+    submittedCount_.fetch_add(1, std::memory_order_relaxed);
+
+    uint32_t d = queue_.size();
+    if (d > maxDepth_.load(std::memory_order_relaxed)) maxDepth_.store(d, std::memory_order_relaxed);
+
+    // Pairs with the fence in run(): the push (release only) must not be
+    // reordered after this load, or both sides could miss each other.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping_.load()) wake();
+  }
+
+  void copyStats(LatencyHistogram& write, LatencyHistogram& inputToPin, OutputWriterCounters& c) const {
+    {
+      std::lock_guard<std::mutex> lock(statsM_);
+      write = write_;
+      inputToPin = inputToPin_;
+    }
+    counters(c);
+  }
+
+  // Any thread; counters only (no lock).
+  void counters(OutputWriterCounters& c) const {
+    c.submitted = submittedCount_.load(std::memory_order_relaxed);
+    c.written = written_.load(std::memory_order_relaxed);
+    c.bytes = bytes_.load(std::memory_order_relaxed);
+    c.coalesced = coalesced_.load(std::memory_order_relaxed);
+    c.dropped = dropped_.load(std::memory_order_relaxed);
+    c.failures = failures_.load(std::memory_order_relaxed);
+    c.underruns = underruns_.load(std::memory_order_relaxed);
+    c.reconnects = reconnects_.load(std::memory_order_relaxed);
+    c.connected = connected_.load(std::memory_order_relaxed);
+    c.depth = queue_.size();
+    c.maxDepth = maxDepth_.load(std::memory_order_relaxed);
+    c.streaming = streaming_;
+    c.measuredRate = measuredRate_.load(std::memory_order_relaxed);
+    c.seconds = (double)(nowNs() - startNs_) / 1e9;
+    c.queueKnown = queueKnown_.load(std::memory_order_relaxed);
+    c.rxQueue = rxQueue_.load(std::memory_order_relaxed);
+    c.txQueue = txQueue_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  void wake() {
+    // Taking the mutex orders us after the writer entered wait() (it holds the
+    // mutex from setting sleeping_ until it blocks). With the fences in submit()
+    // and run(), either the writer sees the new entry or we see sleeping_, so
+    // the notify can't be lost.
+    { std::lock_guard<std::mutex> lock(m_); }
+    cv_.notify_one();
+  }
+
+  void threadMain() {
+    char name[32];
+    std::snprintf(name, sizeof(name), "out %s", target_.serial.c_str());
+    traceSetThreadName(name);
+    if (gRealtime) setThreadRealtime(target_.serial.c_str(), 1);
+    while (connect()) {
+      if (streaming_) runStream();
+      else run();
+      connected_.store(false, std::memory_order_relaxed);
+      backend_->close();
+      if (stop_.load()) return;
+      std::fprintf(stderr, "[out] %s lost, reconnecting\n", target_.serial.c_str());
+    }
+  }
+
+  // Keeps only the newest queued state (while there is no device to write to).
+  void drainLatest() {
+    OutputRequest req;
+    uint64_t n = 0;
+    while (queue_.pop(req)) {
+      std::memcpy(latest_, req.bits6, sizeof(latest_));
+      ++n;
+    }
+    if (n > 1) coalesced_.fetch_add(n - 1, std::memory_order_relaxed);
+  }
+
+  // Opens the backend, re-enumerating with exponential backoff while the
+  // device is missing. Returns false once stop() was called.
+  bool connect() {
+    const bool ftdi = target_.kind == OutputKind::Ft245 || target_.kind == OutputKind::Uart;
+    uint32_t backoffMs = kRetryMinMs;
+    for (int attempt = 0;; ++attempt) {
+      drainLatest();
+      if (stop_.load()) return false;
+
+      OutputTarget t = target_;
+      if (ftdi) t.serial = findFtdiSerial(target_.serial);
+      if (!t.serial.empty() && backend_->open(t)) {
+        if (t.serial != target_.serial) {
+          std::fprintf(stderr, "[out] %s -> %s connected\n", target_.serial.c_str(), t.serial.c_str());
+        } else {
+          std::fprintf(stderr, "[out] %s connected\n", t.serial.c_str());
+        }
+        if (everConnected_) reconnects_.fetch_add(1, std::memory_order_relaxed);
+        everConnected_ = true;
+        connected_.store(true, std::memory_order_relaxed);
+        return true;
+      }
+      if (attempt == 0) {
+        std::fprintf(stderr, "[out] %s not available, retrying in the background\n", target_.serial.c_str());
+      }
+
+      // Not sleeping_: submit() must not cut the backoff short; stop() still wakes us.
+      std::unique_lock<std::mutex> lock(m_);
+      cv_.wait_for(lock, std::chrono::milliseconds(backoffMs), [this] { return stop_.load(); });
+      backoffMs = (std::min)(backoffMs * 2, kRetryMaxMs);
+    }
+  }
+
+  // One state to the backend, timed. Returns false on a write error.
+  bool writeState(const uint8_t* bits6, uint64_t tInput) {
+    const uint64_t tSubmit = nowNs();
+    const int sent = backend_->writePads(bits6);
+    const uint64_t tReturn = nowNs();
+    traceEvent("writePads", tSubmit, tReturn);
+
+    bool ok = sent >= 0;
+    if (ok) {
+      written_.fetch_add(1, std::memory_order_relaxed);
+      bytes_.fetch_add((uint64_t)sent, std::memory_order_relaxed);
+      std::lock_guard<std::mutex> lock(statsM_);
+      write_.record(tReturn - tSubmit);
+      if (tInput) inputToPin_.record(tReturn - tInput);
+    } else {
+      failures_.fetch_add(1, std::memory_order_relaxed);
+    }
+    sampleQueue(tReturn);
+    return ok;
+  }
+
+  // Returns on stop() or once the device looks gone.
+  void run() {
+    OutputRequest req, next;
+    int failuresInRow = 0;
+
+    // Back after a reconnect: put the current state on the pins (open() left idle).
+    if (backend_->needsWrite(latest_) && !writeState(latest_, 0)) ++failuresInRow;
+
+    for (;;) {
+      if (!queue_.pop(req)) {
+        {
+          std::unique_lock<std::mutex> lock(m_);
+          sleeping_.store(true);
+          std::atomic_thread_fence(std::memory_order_seq_cst);   // see submit()
+          if (queue_.empty() && !stop_.load() && !retune_.load()) {
+            if (vsync_) cv_.wait_for(lock, std::chrono::microseconds(VsyncTracker::kPollUs));
+            else cv_.wait_for(lock, std::chrono::milliseconds(backend_->pollMs()));
+          }
+          sleeping_.store(false);
+        }
+        if (stop_.load()) return;
+        if (retune_.exchange(false)) {
+          backend_->retune();   // left the pins as they were, but the cache idle
+          if (backend_->needsWrite(latest_) && !writeState(latest_, 0)) ++failuresInRow;
+        }
+        const uint64_t now = nowNs();
+        countBytes(backend_->poll(now));
+        sampleQueue(now);
+        pollVsync();
+        continue;
+      }
+
+      // Coalesce to the newest queued state; keep the oldest input time.
+      const uint64_t tInput = req.tInputNs;
+      uint64_t skipped = 0;
+      while (queue_.pop(next)) {
+        req = next;
+        ++skipped;
+      }
+      if (skipped) coalesced_.fetch_add(skipped, std::memory_order_relaxed);
+      std::memcpy(latest_, req.bits6, sizeof(latest_));
+
+      if (!backend_->needsWrite(req.bits6)) continue;
+      if (writeState(req.bits6, tInput)) {
+        failuresInRow = 0;
+      } else if (++failuresInRow >= kLostAfterFailures) {
+        return;
+      }
+      pollVsync();
+    }
+  }
+
+  // Writer thread: one pin sample for gVsync, at most every kPollUs / 2.
+  void pollVsync() {
+    if (!vsync_) return;
+    const uint64_t t0 = nowNs();
+    if (t0 - vsyncPolledNs_ < VsyncTracker::kPollUs * 500ull) return;
+    uint8_t pins = 0;
+    if (!backend_->readPins(pins)) return;
+    vsyncPolledNs_ = nowNs();
+    gVsync.onSample(pins, t0, vsyncPolledNs_);
+  }
+
+  // Writer thread: the device queue, at most every 100 ms.
+  void sampleQueue(uint64_t now) {
+    if (now - queueSampledNs_ < 100000000ull) return;
+    queueSampledNs_ = now;
+    uint32_t rx = 0, tx = 0;
+    if (!backend_->queueStatus(rx, tx)) return;
+    rxQueue_.store(rx, std::memory_order_relaxed);
+    txQueue_.store(tx, std::memory_order_relaxed);
+    queueKnown_.store(true, std::memory_order_relaxed);
+  }
+
+  void countBytes(int sent) {
+    if (sent > 0) bytes_.fetch_add((uint64_t)sent, std::memory_order_relaxed);
+    else if (sent < 0) failures_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Active-low live state + turbo + running macro -> active-low output for one
+  // sample. Writer thread only.
+  struct PadWave {
+    uint8_t held = 0;                // active-high live buttons last sample
+    uint64_t turboAnchor[6] = {};    // sample index where each turbo press began
+    int macro = -1;                  // index into gMacros, -1 = idle
+    size_t step = 0;
+    uint64_t stepEnd = 0;            // sample index where the current step ends
+  };
+
+  uint8_t renderPad(int local, uint8_t liveBits6, uint64_t sample) {
+    PadWave& w = wave_[local];
+    const uint8_t live = (uint8_t)(~liveBits6 & 0x3Fu);
+    const uint8_t pressedNow = (uint8_t)(live & ~w.held);
+    w.held = live;
+
+    uint8_t out = live;
+    for (int b = 0; b < 6; ++b) {
+      const float hz = turboHz_[local][b];
+      if (hz <= 0.0f || !(live & (1u << b))) continue;
+      if (pressedNow & (1u << b)) w.turboAnchor[b] = sample;
+      // Two half-periods per cycle; even half = pressed.
+      const uint64_t half = (uint64_t)((double)(sample - w.turboAnchor[b]) * 2.0 * hz / gBitBangRate);
+      if (half & 1u) out = (uint8_t)(out & ~(1u << b));
+    }
+
+    if (w.macro >= 0) {
+      const MacroSpec& m = gMacros[(size_t)w.macro];
+      while (w.macro >= 0 && sample >= w.stepEnd) {
+        if (++w.step >= m.steps.size()) {
+          w.macro = -1;
+        } else {
+          w.stepEnd += framesToSamples(m.steps[w.step].frames);
+        }
+      }
+      if (w.macro >= 0) out |= m.steps[w.step].bits;
+    }
+    return (uint8_t)(~out & 0x3Fu);
   }
 
-  void close() {
-    if (!h_) return;
+  static uint64_t framesToSamples(int frames) {
+    return (uint64_t)frames * gMacroFrameUs * gBitBangRate / 1000000u;
+  }
 
-    // Try to restore safe idle and disable bit-bang.
-    writeBits6(0x3Fu, /*force=*/true);
-    FT_SetBitMode(h_, 0x00, 0x00);
-    FT_Close(h_);
-    h_ = nullptr;
-    last_ = 0xFFu;
+  void startMacro(uint8_t id, uint64_t sample) {
+    const MacroSpec& m = gMacros[id];
+    PadWave& w = wave_[m.pad - target_.firstPad];
+    w.macro = id;
+    w.step = 0;
+    w.stepEnd = sample + framesToSamples(m.steps[0].frames);
   }
 
-  bool isOpen() const { return h_ != nullptr; }
+  void runStream() {
+    Ft245BitBang& dev = *backend_->bitBang();
+    const int bps = dev.bytesPerSample();
+    const int pads = padCount();
+    const uint32_t chunkSamples = (std::max)(1u, gBitBangRate / 1000u);   // 1 ms
+    const uint64_t leadBytes = 3ull * chunkSamples * (uint64_t)bps;          // ~3 ms queued
+    const double nsPerByte = 1e9 / ((double)gBitBangRate * bps);
+
+    if (!dev.setByteRate(gBitBangRate * (uint32_t)bps) || !dev.setBitMode(0x04)) {
+      std::fprintf(stderr, "[wave] %s: synchronous bit-bang unavailable, falling back to direct writes\n",
+        target_.serial.c_str());
+      run();
+      return;
+    }
+    std::fprintf(stderr, "[wave] %s: streaming %u samples/s (%d byte%s/sample)\n",
+      target_.serial.c_str(), gBitBangRate, bps, bps == 1 ? "" : "s");
+
+    std::vector<UCHAR> chunk((size_t)chunkSamples * (size_t)bps);
+    uint8_t live[2];
+    std::memcpy(live, latest_, sizeof(live));   // current state after a reconnect
+    for (PadWave& w : wave_) w = PadWave();
+    int failuresInRow = 0;
+    uint64_t sample = 0, sent = 0, consumed = 0;
+    uint64_t pendingInput = 0;           // tInput of a live change not yet rendered
+    uint64_t rateT0 = 0, rateB0 = 0;
+
+    while (!stop_.load()) {
+      OutputRequest req;
+      uint64_t skipped = 0;
+      bool got = false;
+      while (queue_.pop(req)) {
+        if (got) ++skipped;
+        if (!pendingInput) pendingInput = req.tInputNs;
+        std::memcpy(live, req.bits6, sizeof(live));
+        std::memcpy(latest_, req.bits6, sizeof(latest_));
+        got = true;
+      }
+      if (skipped) coalesced_.fetch_add(skipped, std::memory_order_relaxed);
+      uint8_t id;
+      while (macroQueue_.pop(id)) startMacro(id, sample);
+
+      const long n = dev.drainReadBack();
+      if (n < 0) {
+        failures_.fetch_add(1, std::memory_order_relaxed);
+        if (++failuresInRow >= kLostAfterFailures) return;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        continue;
+      }
+      consumed += (uint64_t)n;
+
+      const uint64_t now = nowNs();
+      sampleQueue(now);
+      if (!rateT0 && consumed) { rateT0 = now; rateB0 = consumed; }
+      if (rateT0 && now - rateT0 >= 1000000000ull) {
+        measuredRate_.store((double)(consumed - rateB0) * 1e9 / (double)(now - rateT0) / bps,
+          std::memory_order_relaxed);
+        rateT0 = now;
+        rateB0 = consumed;
+      }
 
-  bool writeBits6(uint8_t bits6, bool force = false) {
-    if (!h_) return false;
+      if (sent - consumed >= leadBytes) {
+        std::this_thread::sleep_for(std::chrono::microseconds(250));
+        continue;
+      }
+      if (sent && sent == consumed) underruns_.fetch_add(1, std::memory_order_relaxed);
 
-    bits6 = (uint8_t)(bits6 & 0x3Fu);
-    if (!force && bits6 == last_) return true;
+      UCHAR* o = chunk.data();
+      for (uint32_t i = 0; i < chunkSamples; ++i, ++sample) {
+        uint8_t out[2] = {0x3Fu, 0x3Fu};
+        for (int p = 0; p < pads; ++p) out[p] = renderPad(p, live[p], sample);
+        o += dev.renderSample(out, o);
+      }
 
-    UCHAR out = (UCHAR)bits6;
-    DWORD written = 0;
-    FT_STATUS st = FT_Write(h_, &out, 1, &written);
-    if (st != FT_OK || written != 1) {
-      std::fprintf(stderr, "[ft245] FT_Write failed: st=%d written=%lu\n", (int)st, (unsigned long)written);
-      return false;
+      const uint64_t tSubmit = nowNs();
+      const bool ok = dev.writeRaw(chunk.data(), (DWORD)chunk.size());
+      const uint64_t tReturn = nowNs();
+      traceEvent("writeRaw", tSubmit, tReturn);
+      if (!ok) {
+        failures_.fetch_add(1, std::memory_order_relaxed);
+        if (++failuresInRow >= kLostAfterFailures) return;
+        continue;
+      }
+      failuresInRow = 0;
+      const uint64_t queuedAhead = sent - consumed;
+      sent += chunk.size();
+      written_.fetch_add(1, std::memory_order_relaxed);
+      bytes_.fetch_add(chunk.size(), std::memory_order_relaxed);
+
+      std::lock_guard<std::mutex> lock(statsM_);
+      write_.record(tReturn - tSubmit);
+      if (pendingInput) {
+        // The change reaches the pins once the bytes already queued ahead of it
+        // have been clocked out.
+        inputToPin_.record(tReturn - pendingInput + (uint64_t)(queuedAhead * nsPerByte));
+        pendingInput = 0;
+      }
     }
-
-    last_ = bits6;
-    return true;
   }
 
- private:
-  FT_HANDLE h_ = nullptr;
-  uint8_t last_ = 0xFFu;
+  std::unique_ptr<OutputBackend> backend_;   // writer thread only once started
+  OutputTarget target_;
+  uint8_t latest_[kMaxPads];   // writer thread: newest state seen
+  bool everConnected_ = false; // writer thread
+  std::atomic<bool> connected_{false};
+  std::atomic<uint64_t> reconnects_{0};
+  uint64_t startNs_ = 0;
+  std::thread th_;
+  bool streaming_ = false;
+  bool vsync_ = false;            // polls pins for gVsync
+  uint64_t vsyncPolledNs_ = 0;    // writer thread only
+
+  // Streaming only; set in start()
+  float turboHz_[2][6] = {};
+  std::vector<uint8_t> macroIds_;
+  SpscRing<uint8_t, kMacroQueueDepth> macroQueue_;
+  PadWave wave_[2];
+
+  SpscRing<OutputRequest, kQueueDepth> queue_;
+  std::atomic<bool> stop_{false};
+  std::atomic<bool> sleeping_{false};
+  std::atomic<bool> retune_{false};
+  std::mutex m_;
+  std::condition_variable cv_;
+
+  // I/O thread only
+  uint8_t submitted_[kMaxPads];
+  OutputRequest stagedReq_;
+  bool staged_ = false;
+
+  std::atomic<uint64_t> submittedCount_{0};
+  std::atomic<uint64_t> written_{0};
+  std::atomic<uint64_t> bytes_{0};
+  std::atomic<uint64_t> coalesced_{0};
+  std::atomic<uint64_t> dropped_{0};
+  std::atomic<uint64_t> failures_{0};
+  std::atomic<uint64_t> underruns_{0};
+  std::atomic<uint32_t> maxDepth_{0};
+  std::atomic<double> measuredRate_{0.0};
+  uint64_t queueSampledNs_ = 0;   // writer thread only
+  std::atomic<bool> queueKnown_{false};
+  std::atomic<uint32_t> rxQueue_{0};
+  std::atomic<uint32_t> txQueue_{0};
+
+  mutable std::mutex statsM_;   // writer thread vs. stats readers only
+  LatencyHistogram write_;
+  LatencyHistogram inputToPin_;
 };
 
-static Ft245BitBang gFt245;
+static std::vector<std::unique_ptr<OutputWriter>> gWriters;
+
+static void dumpDeviceLatencyStats(std::FILE* fp) {
+  LatencyHistogram write, inputToPin;
+  OutputWriterCounters c;
+  for (const auto& wr : gWriters) {
+    wr->copyStats(write, inputToPin, c);
+    std::fprintf(fp, "[lat] output %s (%s, VPad%d..%d)\n",
+      wr->target().serial.c_str(), outputTargetMode(wr->target()),
+      wr->target().firstPad + 1, wr->target().firstPad + wr->padCount());
+    std::fprintf(fp, "[lat]   queue depth=%u max=%u/%u submitted=%llu written=%llu coalesced=%llu dropped=%llu failures=%llu\n",
+      c.depth, c.maxDepth, OutputWriter::kQueueDepth,
+      (unsigned long long)c.submitted, (unsigned long long)c.written,
+      (unsigned long long)c.coalesced, (unsigned long long)c.dropped,
+      (unsigned long long)c.failures);
+    std::fprintf(fp, "[lat]   %s reconnects=%llu\n", c.connected ? "connected" : "offline",
+      (unsigned long long)c.reconnects);
+    std::fprintf(fp, "[lat]   throughput bytes=%llu (%.0f B/s) writes=%.1f/s\n",
+      (unsigned long long)c.bytes,
+      c.seconds > 0.0 ? (double)c.bytes / c.seconds : 0.0,
+      c.seconds > 0.0 ? (double)c.written / c.seconds : 0.0);
+    if (c.streaming) {
+      std::fprintf(fp, "[lat]   stream rate=%u samples/s measured=%.0f underruns=%llu\n",
+        gBitBangRate, c.measuredRate, (unsigned long long)c.underruns);
+    }
+    dumpLatencyRow(fp, "write", write);
+    dumpLatencyRow(fp, "input->pin", inputToPin);
+  }
+  if (gVsync.enabled()) {
+    const double hz = gVsync.lockedHz();
+    std::fprintf(fp, "[lat] vsync %s", hz > 0.0 ? "locked" : "not locked");
+    if (hz > 0.0) std::fprintf(fp, " %.3f Hz err=%.0f us", hz, gVsync.lastErrUs());
+    std::fprintf(fp, " edges=%llu aligned ticks=%llu\n",
+      (unsigned long long)gVsync.edges(), (unsigned long long)gVsyncAlignedTicks);
+  }
+  for (int i = 0; i < kNativeSlots; ++i) {
+    if (!gNative[i].present.load(std::memory_order_acquire)) continue;
+    char name[sizeof(gNative[i].name)];
+    gNative[i].copyName(name, sizeof(name));
+    std::fprintf(fp, "[lat] hid jid=%d %s events=%llu\n", kNativeJid0 + i, name,
+      (unsigned long long)gNative[i].events.load(std::memory_order_relaxed));
+  }
+  std::fprintf(fp, "[lat] latch min pulse=%.1f ms stretched=%llu merged=%llu\n",
+    (double)gPressLatch.minPulseNs() / 1e6,
+    (unsigned long long)gPressLatch.stretched(), (unsigned long long)gPressLatch.merged());
+}
 #endif // USB2ATARI_ENABLE_FT245
 
 
@@ -352,6 +3654,8 @@ static const char* vkeyName(VKey k) {
 struct VirtualPad {
   Binding bind[(int)VKey::Count];
 
+  // Evaluates against this tick's gKeyDown[] / gJoy[] snapshot; call
+  // updateJoystickCaches() once per tick before sampling any pad.
   Digital6 sample() const {
     Digital6 d;
     d.up = sampleBinding(bind[(int)VKey::Up]);
@@ -364,91 +3668,241 @@ struct VirtualPad {
   }
 };
 
-static VirtualPad gPad[2];
+static VirtualPad gPad[kMaxPads];
+static int gPadCount = 2;                // active pads (--pads / devices)
 
 // -----------------------------------------------------------------------------
-// Joystick state caching for learning edges
+// Compiled binding plan
+// - gPad[] bindings are compiled (load / learn / clear) into structure-of-arrays
+//   term lists, one per source kind. All range checks happen here, so per-tick
+//   evaluation is straight-line loops over the flat snapshot:
+//     key    : gKeyBits[word] & mask
+//     button : gBtnFlat[index]
+//     axis   : gAxisFlat[index] * sign > threshold   (4 lanes at a time)
+// - Each term ORs one bit into its pad's active-high accumulator; eval() returns
+//   the final active-low 6-bit words (same encoding as packBits6ActiveLow()).
+// - VirtualPad::sample() stays as the readable reference; debug builds
+//   cross-check the two every tick.
 // -----------------------------------------------------------------------------
-struct JoyCache {
-  bool present = false;
-  bool isGamepad = false;
-  std::string name;
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+  #include <xmmintrin.h>
+  #define USB2ATARI_AXIS_SSE 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+  #include <arm_neon.h>
+  #define USB2ATARI_AXIS_NEON 1
+#endif
 
-  std::vector<unsigned char> btnPrev;
-  std::vector<float> axisPrev;
+// Returns bit j set when v[j] * sign[j] > th[j], j = 0..3.
+static inline unsigned axisCompare4(const float* v, const float* sign, const float* th) {
+#if defined(USB2ATARI_AXIS_SSE)
+  __m128 x = _mm_mul_ps(_mm_loadu_ps(v), _mm_loadu_ps(sign));
+  return (unsigned)_mm_movemask_ps(_mm_cmpgt_ps(x, _mm_loadu_ps(th)));
+#elif defined(USB2ATARI_AXIS_NEON)
+  static const uint32_t kLane[4] = {1u, 2u, 4u, 8u};
+  float32x4_t x = vmulq_f32(vld1q_f32(v), vld1q_f32(sign));
+  uint32x4_t gt = vcgtq_f32(x, vld1q_f32(th));
+  return (unsigned)vaddvq_u32(vandq_u32(gt, vld1q_u32(kLane)));
+#else
+  unsigned m = 0;
+  for (int j = 0; j < 4; ++j) m |= (unsigned)(v[j] * sign[j] > th[j]) << j;
+  return m;
+#endif
+}
 
-  std::vector<unsigned char> btnCur;
-  std::vector<float> axisCur;
+struct BindPlan {
+  int padCount = 0;
 
-  GLFWgamepadstate gpPrev{};
-  GLFWgamepadstate gpCur{};
-  bool gpHasPrev = false;
-  bool gpHasCur = false;
-};
+  std::vector<uint16_t> keyWord;
+  std::vector<uint64_t> keyMask;
+  std::vector<uint8_t> keyPad, keyBit;
 
-static JoyCache gJoy[GLFW_JOYSTICK_LAST + 1];
+  std::vector<uint16_t> btnIndex;
+  std::vector<uint8_t> btnPad, btnBit;
 
-static const char* jidName(int jid) {
-  const char* n = glfwGetJoystickName(jid);
-  return n ? n : "(unknown)";
-}
+  // Padded to a multiple of 4 with never-true terms (threshold +inf).
+  std::vector<uint16_t> axisIndex;
+  std::vector<float> axisSign, axisThreshold;
+  std::vector<uint8_t> axisPad, axisBit;
 
-static void updateJoystickCaches() {
-  for (int jid = GLFW_JOYSTICK_1; jid <= GLFW_JOYSTICK_LAST; ++jid) {
-    JoyCache& jc = gJoy[jid];
+  // Pads (bit mask) with at least one term on each key, for the key fast path.
+  uint8_t keyPads[GLFW_KEY_LAST + 1] = {};
 
-    jc.present = glfwJoystickPresent(jid);
-    if (!jc.present) {
-      jc.isGamepad = false;
-      jc.name.clear();
-      jc.btnPrev.clear();
-      jc.axisPrev.clear();
-      jc.btnCur.clear();
-      jc.axisCur.clear();
-      jc.gpHasPrev = false;
-      jc.gpHasCur = false;
-      continue;
-    }
+  uint32_t generation = 0;   // set on submit; 0 = the empty initial plan
 
-    jc.isGamepad = glfwJoystickIsGamepad(jid);
-    jc.name = jidName(jid);
+  // out[0..padCount) receives active-low bits6 per pad.
+  void eval(uint8_t* out) const {
+    TRACE_ZONE("BindPlan::eval");
+    for (int p = 0; p < padCount; ++p) out[p] = 0;
 
-    // Raw buttons/axes
-    int nb = 0, na = 0;
-    const unsigned char* btn = glfwGetJoystickButtons(jid, &nb);
-    const float* ax = glfwGetJoystickAxes(jid, &na);
+    const size_t nk = keyWord.size();
+    for (size_t i = 0; i < nk; ++i) {
+      uint8_t on = (uint8_t)((gKeyBits[keyWord[i]] & keyMask[i]) != 0);
+      out[keyPad[i]] |= (uint8_t)(keyBit[i] & (uint8_t)-on);
+    }
 
-    jc.btnPrev = jc.btnCur;
-    jc.axisPrev = jc.axisCur;
+    const size_t nb = btnIndex.size();
+    for (size_t i = 0; i < nb; ++i) {
+      uint8_t on = gBtnFlat[btnIndex[i]];
+      out[btnPad[i]] |= (uint8_t)(btnBit[i] & (uint8_t)-on);
+    }
 
-    jc.btnCur.assign(btn ? btn : nullptr, btn ? btn + nb : nullptr);
-    jc.axisCur.assign(ax ? ax : nullptr, ax ? ax + na : nullptr);
+    const size_t na = axisIndex.size();
+    for (size_t i = 0; i < na; i += 4) {
+      float v[4] = {
+        gAxisFlat[axisIndex[i + 0]], gAxisFlat[axisIndex[i + 1]],
+        gAxisFlat[axisIndex[i + 2]], gAxisFlat[axisIndex[i + 3]]
+      };
+      unsigned m = axisCompare4(v, &axisSign[i], &axisThreshold[i]);
+      for (int j = 0; j < 4; ++j) {
+        uint8_t on = (uint8_t)((m >> j) & 1u);
+        out[axisPad[i + j]] |= (uint8_t)(axisBit[i + j] & (uint8_t)-on);
+      }
+    }
 
-    // Gamepad state (if possible)
-    jc.gpPrev = jc.gpCur;
-    jc.gpHasPrev = jc.gpHasCur;
+    for (int p = 0; p < padCount; ++p) out[p] = (uint8_t)(0x3Fu & ~out[p]);
+  }
+};
 
-    jc.gpHasCur = false;
-    if (jc.isGamepad) {
-      GLFWgamepadstate st;
-      if (glfwGetGamepadState(jid, &st)) {
-        jc.gpCur = st;
-        jc.gpHasCur = true;
-      }
+static void compileBinding(BindPlan& plan, const Binding& b, int pad, int bit) {
+  const uint8_t p = (uint8_t)pad;
+  const uint8_t m = (uint8_t)(1u << bit);
+  const bool jidOk = b.jid >= GLFW_JOYSTICK_1 && b.jid < kJoyCount;
+
+  switch (b.type) {
+    case BindType::Key:
+      if (b.code < 0 || b.code > GLFW_KEY_LAST) return;
+      plan.keyWord.push_back((uint16_t)(b.code >> 6));
+      plan.keyMask.push_back(1ull << (b.code & 63));
+      plan.keyPad.push_back(p);
+      plan.keyBit.push_back(m);
+      plan.keyPads[b.code] |= (uint8_t)(1u << pad);
+      return;
+    case BindType::GamepadButton:
+    case BindType::JoyButton: {
+      bool gp = b.type == BindType::GamepadButton;
+      int limit = gp ? GLFW_GAMEPAD_BUTTON_LAST + 1 : kRawButtonSlots;
+      if (!jidOk || b.code < 0 || b.code >= limit) return;
+      plan.btnIndex.push_back((uint16_t)(b.jid * kBtnStride + (gp ? 0 : kGpButtonSlots) + b.code));
+      plan.btnPad.push_back(p);
+      plan.btnBit.push_back(m);
+      return;
+    }
+    case BindType::GamepadAxisDir:
+    case BindType::JoyAxisDir: {
+      bool gp = b.type == BindType::GamepadAxisDir;
+      int limit = gp ? GLFW_GAMEPAD_AXIS_LAST + 1 : kRawAxisSlots;
+      if (!jidOk || b.code < 0 || b.code >= limit || b.dir == 0) return;
+      plan.axisIndex.push_back((uint16_t)(b.jid * kAxisStride + (gp ? 0 : kGpAxisSlots) + b.code));
+      plan.axisSign.push_back(b.dir < 0 ? -1.0f : 1.0f);
+      plan.axisThreshold.push_back(b.threshold);
+      plan.axisPad.push_back(p);
+      plan.axisBit.push_back(m);
+      return;
     }
+    default:
+      return;
   }
 }
 
+static BindPlan compileBindPlan(const VirtualPad* pads, int padCount) {
+  BindPlan plan;
+  plan.padCount = padCount;
+  for (int p = 0; p < padCount; ++p) {
+    for (int k = 0; k < (int)VKey::Count; ++k) {
+      compileBinding(plan, pads[p].bind[k], p, k);
+    }
+  }
+  while (plan.axisIndex.size() % 4) {
+    plan.axisIndex.push_back(0);
+    plan.axisSign.push_back(1.0f);
+    plan.axisThreshold.push_back(INFINITY);
+    plan.axisPad.push_back(0);
+    plan.axisBit.push_back(0);
+  }
+  return plan;
+}
+
+// The I/O thread evaluates gPlans.current(); edits compile a new plan and
+// submit it. The plan in use is never modified, and the I/O loop adopts new
+// ones at the start of a tick.
+static PublishSlot<BindPlan> gPlans;
+static std::atomic<uint32_t> gPlanGeneration{0};
+
+static void submitBindPlan(const VirtualPad* pads, int padCount) {
+  std::unique_ptr<BindPlan> plan(new BindPlan(compileBindPlan(pads, padCount)));
+  plan->generation = gPlanGeneration.fetch_add(1) + 1;
+  gPlans.submit(std::move(plan));
+}
+
+// I/O thread: recompile from gPad[] and use the result from this point on.
+static void rebuildBindPlan() {
+  submitBindPlan(gPad, gPadCount);
+  gPlans.acquire();
+}
+
 // -----------------------------------------------------------------------------
 // Learning (rebinding) state
 // -----------------------------------------------------------------------------
-static int gEditPad = 0;                 // 0 or 1
+static int gEditPad = 0;                 // 0..gPadCount-1
 static VKey gEditKey = VKey::Up;         // selected virtual control
 static bool gLearning = false;           // armed?
 static float gLearnThreshold = 0.55f;    // slightly higher to avoid noise
 
 static void clearBinding(int padIdx, VKey k) {
   gPad[padIdx].bind[(int)k] = Binding{};
+  rebuildBindPlan();
+}
+
+static void assignLearnedBinding(const Binding& learned) {
+  Binding b = learned;
+  if (b.onJoystick()) b.device = internJoyIdent(gJoy[b.jid].guid, gJoy[b.jid].name);
+  gPad[gEditPad].bind[(int)gEditKey] = b;
+  gLearning = false;
+  rebuildBindPlan();
+}
+
+// Points every binding learned on a device (Binding::device) at the jid that
+// device has now, -1 while it is missing. A binding whose jid still holds its
+// device stays. The rest take the matching device with the lowest jid that no
+// other pad is bound to, else any match, so two identical pads stay apart
+// (they may swap when both are replugged). Bindings without an identity (an
+// older padmap.txt) adopt the device on their jid. Returns true if a jid changed.
+static bool resolveJoystickBindings() {
+  bool changed = false;
+  uint32_t padsOn[kJoyCount] = {};   // bit p: pad p already bound there
+
+  for (int p = 0; p < kMaxPads; ++p) {
+    for (Binding& b : gPad[p].bind) {
+      if (!b.onJoystick()) continue;
+      const bool jidOk = b.jid >= 0 && b.jid < kJoyCount;
+      if (b.device < 0 && jidOk && gJoy[b.jid].present) b.device = internJoyIdent(gJoy[b.jid].guid, gJoy[b.jid].name);
+      if (b.device < 0) continue;
+      if (jidOk && joystickIs(b.jid, b.device)) {
+        padsOn[b.jid] |= 1u << p;
+      } else if (b.jid != -1) {
+        b.jid = -1;
+        changed = true;
+      }
+    }
+  }
+
+  for (int p = 0; p < kMaxPads; ++p) {
+    for (Binding& b : gPad[p].bind) {
+      if (!b.onJoystick() || b.device < 0 || b.jid >= 0) continue;
+      int freeJid = -1, anyJid = -1;
+      for (int i = 0; i < gJoyActiveCount; ++i) {
+        const int jid = gJoyActive[i];
+        if (!joystickIs(jid, b.device)) continue;
+        if (anyJid < 0 || jid < anyJid) anyJid = jid;
+        if (!(padsOn[jid] & ~(1u << p)) && (freeJid < 0 || jid < freeJid)) freeJid = jid;
+      }
+      b.jid = freeJid >= 0 ? freeJid : anyJid;
+      if (b.jid < 0) continue;
+      padsOn[b.jid] |= 1u << p;
+      changed = true;
+    }
+  }
+  return changed;
 }
 
 static void setDefaultBindings() {
@@ -467,22 +3921,21 @@ static void setDefaultBindings() {
   gPad[1].bind[(int)VKey::Right] = Binding{BindType::Key, -1, GLFW_KEY_RIGHT, 0, 0.0f};
   gPad[1].bind[(int)VKey::B1]    = Binding{BindType::Key, -1, GLFW_KEY_N, 0, 0.0f};
   gPad[1].bind[(int)VKey::B2]    = Binding{BindType::Key, -1, GLFW_KEY_M, 0, 0.0f};
+
+  rebuildBindPlan();
 }
 
 static bool detectAnyKeyPress(int& outKey) {
-  for (int k = 0; k <= GLFW_KEY_LAST; ++k) {
-    if (gKeyDown[k] && !gKeyDownPrev[k]) {
-      outKey = k;
-      return true;
-    }
-  }
-  return false;
+  if (gTickKeyPressCount == 0) return false;
+  outKey = gTickKeyPresses[0];
+  return true;
 }
 
 static bool detectGamepadButtonPress(int& outJid, int& outBtn) {
-  for (int jid = GLFW_JOYSTICK_1; jid <= GLFW_JOYSTICK_LAST; ++jid) {
+  for (int i = 0; i < gJoyActiveCount; ++i) {
+    const int jid = gJoyActive[i];
     JoyCache& jc = gJoy[jid];
-    if (!jc.present || !jc.isGamepad) continue;
+    if (!jc.isGamepad) continue;
     if (!jc.gpHasCur || !jc.gpHasPrev) continue;
 
     for (int b = 0; b <= GLFW_GAMEPAD_BUTTON_LAST; ++b) {
@@ -499,9 +3952,10 @@ static bool detectGamepadButtonPress(int& outJid, int& outBtn) {
 }
 
 static bool detectGamepadAxisMove(int& outJid, int& outAxis, int& outDir) {
-  for (int jid = GLFW_JOYSTICK_1; jid <= GLFW_JOYSTICK_LAST; ++jid) {
+  for (int i = 0; i < gJoyActiveCount; ++i) {
+    const int jid = gJoyActive[i];
     JoyCache& jc = gJoy[jid];
-    if (!jc.present || !jc.isGamepad) continue;
+    if (!jc.isGamepad) continue;
     if (!jc.gpHasCur || !jc.gpHasPrev) continue;
 
     for (int a = 0; a <= GLFW_GAMEPAD_AXIS_LAST; ++a) {
@@ -525,16 +3979,20 @@ static bool detectGamepadAxisMove(int& outJid, int& outAxis, int& outDir) {
 }
 
 static bool detectJoyButtonPress(int& outJid, int& outBtn) {
-  for (int jid = GLFW_JOYSTICK_1; jid <= GLFW_JOYSTICK_LAST; ++jid) {
+  // Native slots first: they see a press before GLFW's copy of the same pad.
+  for (int i = 0; i < 2 * gJoyActiveCount; ++i) {
+    const int jid = gJoyActive[i % gJoyActiveCount];
+    if ((jid >= kNativeJid0) != (i < gJoyActiveCount)) continue;
     JoyCache& jc = gJoy[jid];
-    if (!jc.present) continue;
 
-    int n = (int)jc.btnCur.size();
-    if ((int)jc.btnPrev.size() != n) continue;
+    const JoyButtons& bc = jc.btnCur();
+    const JoyButtons& bp = jc.btnPrev();
+    int n = bc.size();
+    if (bp.size() != n) continue;
 
     for (int b = 0; b < n; ++b) {
-      bool cur = jc.btnCur[b] == GLFW_PRESS;
-      bool prev = jc.btnPrev[b] == GLFW_PRESS;
+      bool cur = bc[b] == GLFW_PRESS;
+      bool prev = bp[b] == GLFW_PRESS;
       if (cur && !prev) {
         outJid = jid;
         outBtn = b;
@@ -542,155 +4000,828 @@ static bool detectJoyButtonPress(int& outJid, int& outBtn) {
       }
     }
   }
-  return false;
-}
+  return false;
+}
+
+static bool detectJoyAxisMove(int& outJid, int& outAxis, int& outDir) {
+  // Native slots first: they see a press before GLFW's copy of the same pad.
+  for (int i = 0; i < 2 * gJoyActiveCount; ++i) {
+    const int jid = gJoyActive[i % gJoyActiveCount];
+    if ((jid >= kNativeJid0) != (i < gJoyActiveCount)) continue;
+    JoyCache& jc = gJoy[jid];
+
+    const JoyAxes& ac = jc.axisCur();
+    const JoyAxes& ap = jc.axisPrev();
+    int n = ac.size();
+    if (ap.size() != n) continue;
+
+    for (int a = 0; a < n; ++a) {
+      float cur = ac[a];
+      float prev = ap[a];
+
+      if (std::fabs(prev) < 0.20f) {
+        if (cur > gLearnThreshold) {
+          outJid = jid; outAxis = a; outDir = +1;
+          return true;
+        }
+        if (cur < -gLearnThreshold) {
+          outJid = jid; outAxis = a; outDir = -1;
+          return true;
+        }
+      }
+    }
+  }
+  return false;
+}
+
+static void applyLearningIfTriggered() {
+  TRACE_ZONE("applyLearningIfTriggered");
+  if (!gLearning) return;
+
+  Binding b;
+
+  // 1) Keyboard
+  int key = -1;
+  if (detectAnyKeyPress(key)) {
+    b.type = BindType::Key;
+    b.code = key;
+    b.jid = -1;
+    assignLearnedBinding(b);
+    return;
+  }
+
+  // 2) Gamepad button/axis
+  int jid = -1, code = -1, dir = 0;
+  if (detectGamepadButtonPress(jid, code)) {
+    b.type = BindType::GamepadButton;
+    b.jid = jid;
+    b.code = code;
+    assignLearnedBinding(b);
+    return;
+  }
+  if (detectGamepadAxisMove(jid, code, dir)) {
+    b.type = BindType::GamepadAxisDir;
+    b.jid = jid;
+    b.code = code;
+    b.dir = dir;
+    b.threshold = 0.45f;
+    assignLearnedBinding(b);
+    return;
+  }
+
+  // 3) Raw joystick button/axis
+  if (detectJoyButtonPress(jid, code)) {
+    // If it's gamepad, gamepad path already handled above, but raw is still allowed.
+    b.type = BindType::JoyButton;
+    b.jid = jid;
+    b.code = code;
+    assignLearnedBinding(b);
+    return;
+  }
+  if (detectJoyAxisMove(jid, code, dir)) {
+    b.type = BindType::JoyAxisDir;
+    b.jid = jid;
+    b.code = code;
+    b.dir = dir;
+    b.threshold = 0.45f;
+    assignLearnedBinding(b);
+    return;
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Save / Load mapping
+// - padmap.txt: one binding per line, "pad key type jid code dir threshold
+//   [guid name]" (guid "-" for native devices; the name runs to the end of
+//   the line). Lines without the identity come from older versions.
+// - Disk work runs on the map file thread (gMapFiles). F5 only formats the
+//   bindings on the I/O thread; F9 and file changes are parsed and validated
+//   there, and the I/O loop adopts a parsed PadMap whole at the start of a
+//   tick, so the output neither waits on the disk nor sees a partial file.
+// - The thread checks the file's mtime and size every kPollMs and reloads on
+//   a change that has settled for one check, so copying another profile over
+//   padmap.txt takes effect in a running game. A file with any bad line is
+//   rejected and the current bindings stay.
+// - Saves go to padmap.txt.tmp first and are renamed over padmap.txt.
+// -----------------------------------------------------------------------------
+static const char* kMapFile = "padmap.txt";
+
+// A parsed padmap.txt. Device identities stay text until the I/O thread
+// interns them (gJoyIdents is its table).
+struct PadMap {
+  Binding bind[kMaxPads][(int)VKey::Count];
+  bool hasDevice[kMaxPads][(int)VKey::Count] = {};
+  char guid[kMaxPads][(int)VKey::Count][33] = {};
+  char name[kMaxPads][(int)VKey::Count][128] = {};
+};
+
+static bool validBinding(const Binding& b) {
+  const bool jidOk = b.jid >= -1 && b.jid < kJoyCount;
+  const bool axisOk = (b.dir == -1 || b.dir == 1) && b.threshold > 0.0f && b.threshold <= 1.0f;
+  switch (b.type) {
+    case BindType::None:
+      return true;
+    case BindType::Key:
+      return b.code >= 0 && b.code <= GLFW_KEY_LAST;
+    case BindType::GamepadButton:
+      return jidOk && b.code >= 0 && b.code <= GLFW_GAMEPAD_BUTTON_LAST;
+    case BindType::GamepadAxisDir:
+      return jidOk && axisOk && b.code >= 0 && b.code <= GLFW_GAMEPAD_AXIS_LAST;
+    case BindType::JoyButton:
+      return jidOk && b.code >= 0 && b.code < kRawButtonSlots;
+    case BindType::JoyAxisDir:
+      return jidOk && axisOk && b.code >= 0 && b.code < kRawAxisSlots;
+    default:
+      return false;
+  }
+}
+
+// Any thread. Unlisted bindings are None. False if the file is missing or
+// has a bad line (err says which).
+static bool parsePadMap(const char* path, PadMap& map, char* err, size_t errSize) {
+  std::FILE* fp = std::fopen(path, "rb");
+  if (!fp) {
+    std::snprintf(err, errSize, "cannot open %s", path);
+    return false;
+  }
+
+  char line[512];
+  int lineNo = 0;
+  bool ok = true;
+  while (std::fgets(line, sizeof(line), fp)) {
+    ++lineNo;
+    if (line[std::strspn(line, " \t\r\n")] == '\0') continue;
+
+    int p = 0, k = 0, type = 0, used = 0;
+    Binding b;
+    int r = std::sscanf(line, "%d %d %d %d %d %d %f %n", &p, &k, &type, &b.jid, &b.code, &b.dir, &b.threshold, &used);
+    b.type = (BindType)type;
+    if (r != 7 || p < 0 || p >= kMaxPads || k < 0 || k >= (int)VKey::Count || !validBinding(b)) {
+      std::snprintf(err, errSize, "%s:%d: bad binding", path, lineNo);
+      ok = false;
+      break;
+    }
+    map.bind[p][k] = b;
+
+    // Device identity (absent in files from before GUID matching).
+    char guid[33] = {};
+    int nameAt = 0;
+    if (b.onJoystick() && std::sscanf(line + used, "%32s %n", guid, &nameAt) == 1 && nameAt > 0) {
+      char* name = line + used + nameAt;
+      name[std::strcspn(name, "\r\n")] = '\0';
+      map.hasDevice[p][k] = true;
+      std::snprintf(map.guid[p][k], sizeof(map.guid[p][k]), "%s", std::strcmp(guid, "-") == 0 ? "" : guid);
+      std::snprintf(map.name[p][k], sizeof(map.name[p][k]), "%s", name);
+    }
+  }
+  std::fclose(fp);
+  return ok;
+}
+
+// I/O thread: all bindings at once, then one plan swap.
+static void applyPadMap(const PadMap& map) {
+  for (int p = 0; p < kMaxPads; ++p) {
+    for (int k = 0; k < (int)VKey::Count; ++k) {
+      Binding b = map.bind[p][k];
+      if (map.hasDevice[p][k]) b.device = internJoyIdent(map.guid[p][k], map.name[p][k]);
+      gPad[p].bind[k] = b;
+    }
+  }
+  resolveJoystickBindings();
+  rebuildBindPlan();
+}
+
+// I/O thread: the file contents for the current bindings. Every pad, not just
+// gPadCount: a load replaces all kMaxPads, so a --pads 2 session must not
+// drop what a --pads 8 one saved.
+static std::string formatPadMap() {
+  std::string text;
+  char line[256];
+  for (int p = 0; p < kMaxPads; ++p) {
+    for (int k = 0; k < (int)VKey::Count; ++k) {
+      const Binding& b = gPad[p].bind[k];
+      int n = std::snprintf(line, sizeof(line), "%d %d %d %d %d %d %.6f",
+        p, k, (int)b.type, b.jid, b.code, b.dir, b.threshold);
+      if (b.device >= 0) {
+        const JoyIdent& id = gJoyIdents[b.device];
+        n += std::snprintf(line + n, sizeof(line) - (size_t)n, " %s %s", id.guid[0] ? id.guid : "-", id.name);
+      }
+      text.append(line, (size_t)(std::min)(n, (int)sizeof(line) - 1));
+      text += '\n';
+    }
+  }
+  return text;
+}
+
+// Startup, before the I/O loop runs.
+static bool loadMappings() {
+  std::unique_ptr<PadMap> map(new PadMap());
+  char err[160];
+  if (!parsePadMap(kMapFile, *map, err, sizeof(err))) {
+    if (std::FILE* fp = std::fopen(kMapFile, "rb")) {
+      std::fclose(fp);
+      std::fprintf(stderr, "[map] %s\n", err);
+    }
+    return false;
+  }
+  applyPadMap(*map);
+  return true;
+}
+
+// Writes path.tmp and renames it over path, so readers (and a crash) see
+// either the old file or the new one.
+static bool writeFileReplacing(const char* path, const std::string& text) {
+  const std::string tmp = std::string(path) + ".tmp";
+  std::FILE* fp = std::fopen(tmp.c_str(), "wb");
+  if (!fp) return false;
+  bool ok = std::fwrite(text.data(), 1, text.size(), fp) == text.size() && std::fflush(fp) == 0;
+#ifndef _WIN32
+  ok = ok && fsync(fileno(fp)) == 0;
+#endif
+  ok = std::fclose(fp) == 0 && ok;
+#ifdef _WIN32
+  ok = ok && MoveFileExA(tmp.c_str(), path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+  ok = ok && std::rename(tmp.c_str(), path) == 0;
+#endif
+  if (!ok) std::remove(tmp.c_str());
+  return ok;
+}
+
+struct FileStamp {
+  bool exists = false;
+  int64_t mtime = 0;       // seconds
+  int64_t mtimeNs = 0;     // sub-second part
+  int64_t size = 0;
+  bool operator==(const FileStamp& o) const {
+    return exists == o.exists && mtime == o.mtime && mtimeNs == o.mtimeNs && size == o.size;
+  }
+  bool operator!=(const FileStamp& o) const { return !(*this == o); }
+};
+
+static FileStamp fileStamp(const char* path) {
+  FileStamp s;
+#ifdef _WIN32
+  // _stat64 has whole seconds; FILETIME counts 100 ns since 1601.
+  WIN32_FILE_ATTRIBUTE_DATA fa;
+  if (!GetFileAttributesExA(path, GetFileExInfoStandard, &fa)) return s;
+  const uint64_t t = ((uint64_t)fa.ftLastWriteTime.dwHighDateTime << 32) | fa.ftLastWriteTime.dwLowDateTime;
+  s.exists = true;
+  s.mtime = (int64_t)(t / 10000000u);
+  s.mtimeNs = (int64_t)(t % 10000000u) * 100;
+  s.size = (int64_t)(((uint64_t)fa.nFileSizeHigh << 32) | fa.nFileSizeLow);
+#else
+  struct stat st;
+  if (stat(path, &st) != 0) return s;
+  s.exists = true;
+  s.mtime = (int64_t)st.st_mtime;
+#if defined(__APPLE__)
+  s.mtimeNs = (int64_t)st.st_mtimespec.tv_nsec;
+#else
+  s.mtimeNs = (int64_t)st.st_mtim.tv_nsec;
+#endif
+  s.size = (int64_t)st.st_size;
+#endif
+  return s;
+}
+
+class MapFileThread {
+ public:
+  static constexpr int kPollMs = 500;
+
+  ~MapFileThread() { stop(); }
+
+  void start() {
+    stamp_ = settling_ = fileStamp(kMapFile);
+    stop_ = false;
+    th_ = std::thread(&MapFileThread::run, this);
+  }
+
+  // Writes a save still pending before returning.
+  void stop() {
+    {
+      std::lock_guard<std::mutex> lock(m_);
+      stop_ = true;
+    }
+    cv_.notify_one();
+    if (th_.joinable()) th_.join();
+  }
+
+  // I/O thread (F5). A newer save replaces one not written yet.
+  void save(std::string text) {
+    {
+      std::lock_guard<std::mutex> lock(m_);
+      saveText_ = std::move(text);
+      saveWanted_ = true;
+    }
+    cv_.notify_one();
+  }
+
+  // I/O thread (F9): parse now, changed or not.
+  void reload() {
+    {
+      std::lock_guard<std::mutex> lock(m_);
+      reloadWanted_ = true;
+    }
+    cv_.notify_one();
+  }
+
+  // I/O thread, start of a tick: adopts a parsed file if one is waiting.
+  void adopt() {
+    if (!loaded_.acquire()) return;
+    applyPadMap(loaded_.current());
+    std::fprintf(stderr, "[map] loaded from %s\n", kMapFile);
+  }
+
+ private:
+  void run() {
+    std::unique_lock<std::mutex> lock(m_);
+    for (;;) {
+      cv_.wait_for(lock, std::chrono::milliseconds(kPollMs),
+        [this] { return stop_ || saveWanted_ || reloadWanted_; });
+      if (saveWanted_) {
+        std::string text;
+        text.swap(saveText_);
+        saveWanted_ = false;
+        lock.unlock();
+        const bool ok = writeFileReplacing(kMapFile, text);
+        if (ok) stamp_ = settling_ = fileStamp(kMapFile);   // our own write is no change
+        std::fprintf(stderr, ok ? "[map] saved to %s\n" : "[map] saving %s failed\n", kMapFile);
+        lock.lock();
+      }
+      if (stop_) return;
+      const bool forced = reloadWanted_;
+      reloadWanted_ = false;
+      lock.unlock();
+      check(forced);
+      lock.lock();
+    }
+  }
+
+  void check(bool forced) {
+    const FileStamp now = fileStamp(kMapFile);
+    if (!forced) {
+      if (now == stamp_) return;
+      if (now != settling_) {
+        settling_ = now;   // maybe still being written; look again next time
+        return;
+      }
+      stamp_ = now;
+      if (!now.exists) return;   // deleted: keep what we have
+    } else {
+      stamp_ = settling_ = now;
+    }
+
+    std::unique_ptr<PadMap> map(new PadMap());
+    char err[160];
+    if (!parsePadMap(kMapFile, *map, err, sizeof(err))) {
+      std::fprintf(stderr, "[map] %s, keeping the current bindings\n", err);
+      return;
+    }
+    loaded_.submit(std::move(map));
+  }
 
-static bool detectJoyAxisMove(int& outJid, int& outAxis, int& outDir) {
-  for (int jid = GLFW_JOYSTICK_1; jid <= GLFW_JOYSTICK_LAST; ++jid) {
-    JoyCache& jc = gJoy[jid];
-    if (!jc.present) continue;
+  PublishSlot<PadMap> loaded_;   // map file thread -> I/O thread
+  FileStamp stamp_;              // map file thread: last loaded or written
+  FileStamp settling_;           // map file thread: last seen
+  std::thread th_;
+  std::mutex m_;
+  std::condition_variable cv_;
+  bool stop_ = false;
+  bool saveWanted_ = false;
+  bool reloadWanted_ = false;
+  std::string saveText_;
+};
 
-    int n = (int)jc.axisCur.size();
-    if ((int)jc.axisPrev.size() != n) continue;
+static MapFileThread gMapFiles;
 
-    for (int a = 0; a < n; ++a) {
-      float cur = jc.axisCur[a];
-      float prev = jc.axisPrev[a];
+// -----------------------------------------------------------------------------
+// Input recording / replay
+// - --record FILE appends every pad's active-low bits6 (the BindPlan output,
+//   same encoding as packBits6ActiveLow) to a compact binary log.
+// - Only changes are stored: a tick where nothing changed costs nothing, so
+//   long sessions stay small. The log has no index or trailer; a crash leaves
+//   a valid prefix.
+// - --replay FILE memory-maps the log and walks it in place (no parse pass),
+//   driving the FT245 writers at the recorded timing with bindings ignored.
+// - Entries collect in a 4 KB buffer that is written, unbuffered by stdio, on
+//   the I/O thread. Under writeback pressure that write can block a tick; it
+//   happens at most once per 4 KB of changes. A failed write (disk full, I/O
+//   error) logs [rec], stops the recording and keeps what made it to disk.
+//
+// Layout (little-endian):
+//   header  : "U2AREC" u8 version(1) u8 padCount u32 tickUs u32 reserved
+//   entry   : varint dtUs (since previous entry), u8 changedMask,
+//             one bits6 byte per set mask bit (pad order)
+// The last entry of a cleanly closed log has mask 0 and marks the end time.
+// -----------------------------------------------------------------------------
+static const char kRecMagic[6] = {'U', '2', 'A', 'R', 'E', 'C'};
+static const uint8_t kRecVersion = 1;
+static const size_t kRecHeaderSize = 16;
 
-      if (std::fabs(prev) < 0.20f) {
-        if (cur > gLearnThreshold) {
-          outJid = jid; outAxis = a; outDir = +1;
-          return true;
-        }
-        if (cur < -gLearnThreshold) {
-          outJid = jid; outAxis = a; outDir = -1;
-          return true;
-        }
-      }
+class InputRecorder {
+ public:
+  ~InputRecorder() { close(); }
+
+  bool open(const char* path, int padCount, uint32_t tickUs) {
+    close();
+    fp_ = std::fopen(path, "wb");
+    if (!fp_) {
+      std::fprintf(stderr, "[rec] cannot create %s\n", path);
+      return false;
+    }
+    std::setvbuf(fp_, nullptr, _IONBF, 0);   // buf_ is the buffer; errors show up at once
+    path_ = path;
+    uint8_t h[kRecHeaderSize] = {};
+    std::memcpy(h, kRecMagic, sizeof(kRecMagic));
+    h[6] = kRecVersion;
+    h[7] = (uint8_t)padCount;
+    for (int i = 0; i < 4; ++i) h[8 + i] = (uint8_t)(tickUs >> (8 * i));
+    if (std::fwrite(h, 1, sizeof(h), fp_) != sizeof(h)) {
+      std::fprintf(stderr, "[rec] cannot write %s: %s\n", path, std::strerror(errno));
+      std::fclose(fp_);
+      fp_ = nullptr;
+      return false;
     }
+    padCount_ = padCount;
+    started_ = false;
+    entries_ = 0;
+    bytes_ = sizeof(h);
+    n_ = 0;
+    std::memset(last_, 0x3F, sizeof(last_));
+    std::fprintf(stderr, "[rec] recording %d pad(s) to %s\n", padCount, path);
+    return true;
   }
-  return false;
-}
 
-static void applyLearningIfTriggered() {
-  if (!gLearning) return;
+  bool isOpen() const { return fp_ != nullptr; }
 
-  Binding b;
+  // I/O thread, once per tick. Buffered; the file only sees 4 KB writes.
+  void tick(uint64_t tNs, const uint8_t* bits6) {
+    if (!fp_) return;
+    if (!started_) {
+      t0Ns_ = tNs;
+      lastUs_ = 0;
+      started_ = true;
+      std::memset(last_, 0xFF, sizeof(last_));   // first entry carries the full state
+    }
+    uint8_t mask = 0;
+    for (int p = 0; p < padCount_; ++p) {
+      if (bits6[p] != last_[p]) mask |= (uint8_t)(1u << p);
+    }
+    if (!mask) return;
+    append(tNs, mask, bits6);
+  }
 
-  // 1) Keyboard
-  int key = -1;
-  if (detectAnyKeyPress(key)) {
-    b.type = BindType::Key;
-    b.code = key;
-    b.jid = -1;
-    gPad[gEditPad].bind[(int)gEditKey] = b;
-    gLearning = false;
-    return;
+  void close() {
+    if (!fp_) return;
+    if (started_) append(nowNs(), 0, last_);   // end marker
+    if (!flush()) return;
+    const bool ok = std::fclose(fp_) == 0;
+    fp_ = nullptr;
+    if (!ok) {
+      std::fprintf(stderr, "[rec] closing %s failed: %s\n", path_.c_str(), std::strerror(errno));
+      return;
+    }
+    std::fprintf(stderr, "[rec] closed: %llu entries, %llu bytes\n",
+      (unsigned long long)entries_, (unsigned long long)bytes_);
   }
 
-  // 2) Gamepad button/axis
-  int jid = -1, code = -1, dir = 0;
-  if (detectGamepadButtonPress(jid, code)) {
-    b.type = BindType::GamepadButton;
-    b.jid = jid;
-    b.code = code;
-    gPad[gEditPad].bind[(int)gEditKey] = b;
-    gLearning = false;
-    return;
+ private:
+  void append(uint64_t tNs, uint8_t mask, const uint8_t* bits6) {
+    // Worst case: 10-byte varint + mask + kMaxPads bytes.
+    if (n_ + 11 + kMaxPads > sizeof(buf_) && !flush()) return;
+    // Key fast-path entries carry event times that can be later than the
+    // following tick's poll time; never go backwards.
+    const uint64_t us = (std::max)(tNs > t0Ns_ ? (tNs - t0Ns_) / 1000u : 0, lastUs_);
+    uint64_t dt = us - lastUs_;
+    lastUs_ = us;
+    do {
+      uint8_t b = (uint8_t)(dt & 0x7Fu);
+      dt >>= 7;
+      buf_[n_++] = dt ? (uint8_t)(b | 0x80u) : b;
+    } while (dt);
+    buf_[n_++] = mask;
+    for (int p = 0; p < padCount_; ++p) {
+      if (!(mask & (1u << p))) continue;
+      buf_[n_++] = bits6[p];
+      last_[p] = bits6[p];
+    }
+    ++entries_;
   }
-  if (detectGamepadAxisMove(jid, code, dir)) {
-    b.type = BindType::GamepadAxisDir;
-    b.jid = jid;
-    b.code = code;
-    b.dir = dir;
-    b.threshold = 0.45f;
-    gPad[gEditPad].bind[(int)gEditKey] = b;
-    gLearning = false;
-    return;
+
+  // False (and the recording stopped) if the file did not take it all.
+  bool flush() {
+    if (!n_) return true;
+    const size_t written = std::fwrite(buf_, 1, n_, fp_);
+    bytes_ += written;
+    if (written != n_) {
+      std::fprintf(stderr, "[rec] writing %s failed (%s); recording stopped, %llu bytes on disk\n",
+        path_.c_str(), std::strerror(errno), (unsigned long long)bytes_);
+      std::fclose(fp_);
+      fp_ = nullptr;
+      n_ = 0;
+      return false;
+    }
+    n_ = 0;
+    return true;
   }
 
-  // 3) Raw joystick button/axis
-  if (detectJoyButtonPress(jid, code)) {
-    // If it's gamepad, gamepad path already handled above, but raw is still allowed.
-    b.type = BindType::JoyButton;
-    b.jid = jid;
-    b.code = code;
-    gPad[gEditPad].bind[(int)gEditKey] = b;
-    gLearning = false;
-    return;
+  std::FILE* fp_ = nullptr;
+  std::string path_;
+  int padCount_ = 0;
+  bool started_ = false;
+  uint64_t t0Ns_ = 0;
+  uint64_t lastUs_ = 0;
+  uint8_t last_[kMaxPads];
+  uint8_t buf_[4096];
+  size_t n_ = 0;
+  uint64_t entries_ = 0;
+  uint64_t bytes_ = 0;
+};
+
+static InputRecorder gRecorder;
+
+// Read-only memory mapping of a whole file.
+class MappedFile {
+ public:
+  ~MappedFile() { close(); }
+
+  bool open(const char* path) {
+    close();
+#ifdef _WIN32
+    file_ = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+      OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file_ == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER sz;
+    if (!GetFileSizeEx(file_, &sz) || sz.QuadPart == 0) { close(); return false; }
+    map_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!map_) { close(); return false; }
+    data_ = (const uint8_t*)MapViewOfFile(map_, FILE_MAP_READ, 0, 0, 0);
+    if (!data_) { close(); return false; }
+    size_ = (size_t)sz.QuadPart;
+#else
+    fd_ = ::open(path, O_RDONLY);
+    if (fd_ < 0) return false;
+    struct stat st;
+    if (fstat(fd_, &st) != 0 || st.st_size == 0) { close(); return false; }
+    void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if (p == MAP_FAILED) { close(); return false; }
+    madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+    data_ = (const uint8_t*)p;
+    size_ = (size_t)st.st_size;
+#endif
+    return true;
   }
-  if (detectJoyAxisMove(jid, code, dir)) {
-    b.type = BindType::JoyAxisDir;
-    b.jid = jid;
-    b.code = code;
-    b.dir = dir;
-    b.threshold = 0.45f;
-    gPad[gEditPad].bind[(int)gEditKey] = b;
-    gLearning = false;
-    return;
+
+  void close() {
+#ifdef _WIN32
+    if (data_) UnmapViewOfFile(data_);
+    if (map_) CloseHandle(map_);
+    if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+    map_ = nullptr;
+    file_ = INVALID_HANDLE_VALUE;
+#else
+    if (data_) munmap((void*)data_, size_);
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+#endif
+    data_ = nullptr;
+    size_ = 0;
   }
-}
+
+  const uint8_t* data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+#ifdef _WIN32
+  HANDLE file_ = INVALID_HANDLE_VALUE;
+  HANDLE map_ = nullptr;
+#else
+  int fd_ = -1;
+#endif
+  const uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+// Walks recorded entries in place. next() applies one entry to bits6 and
+// advances tUs to its time; returns false at the end (or on a truncated entry).
+struct ReplayCursor {
+  const uint8_t* p = nullptr;
+  const uint8_t* end = nullptr;
+  int padCount = 0;
+  uint64_t tUs = 0;
+  uint8_t bits6[kMaxPads];
+
+  bool next() {
+    uint64_t dt = 0;
+    for (int shift = 0;; shift += 7) {
+      if (p >= end || shift > 63) return false;
+      const uint8_t b = *p++;
+      dt |= (uint64_t)(b & 0x7Fu) << shift;
+      if (!(b & 0x80u)) break;
+    }
+    if (p >= end) return false;
+    const uint8_t mask = *p++;
+    for (int i = 0; i < padCount; ++i) {
+      if (!(mask & (1u << i))) continue;
+      if (p >= end) return false;
+      bits6[i] = (uint8_t)(*p++ & 0x3Fu);
+    }
+    tUs += dt;
+    return true;
+  }
+};
 
 // -----------------------------------------------------------------------------
-// Save / Load mapping
+// Network transport (UDP)
+// - --udp-send HOST:PORT streams the pad states (the same active-low bits6 the
+//   FT245 gets) to a remote usb2atari running --udp-listen, which drives its
+//   local devices. One datagram carries all pads:
+//     u8 'U' u8 '2' u8 version(1) u8 padCount u32 session u32 seq bits6[padCount]
+//   (little-endian, 12 + padCount bytes).
+// - The sender is an output target like a device (UdpBackend below), so it
+//   runs on its own writer thread. A new state gets a new seq and is sent
+//   immediately (also from the key fast path), then repeated kUdpRepeats times
+//   1 ms apart and as a keepalive every kUdpKeepaliveMs, so a lost datagram
+//   costs about a millisecond.
+// - The receiver applies a datagram only if its seq is newer than the last one
+//   applied (wrap-safe); duplicates and late/reordered packets are dropped. A
+//   new session id (sender restart) resets the sequence. Without traffic for
+//   kUdpTimeoutMs all pads go idle, so a dropped link cannot hold a button.
 // -----------------------------------------------------------------------------
-static const char* kMapFile = "padmap.txt";
+static const int kUdpRepeats = 2;
+static const int kUdpKeepaliveMs = 100;
+static const int kUdpTimeoutMs = 500;
+static const uint8_t kUdpVersion = 1;
+static const size_t kUdpHeaderSize = 12;
 
-static bool saveMappings() {
-  std::FILE* fp = std::fopen(kMapFile, "wb");
-  if (!fp) return false;
+#ifdef _WIN32
+typedef SOCKET SocketHandle;
+static const SocketHandle kNoSocket = INVALID_SOCKET;
+static void closeSocket(SocketHandle s) { closesocket(s); }
+#else
+typedef int SocketHandle;
+static const SocketHandle kNoSocket = -1;
+static void closeSocket(SocketHandle s) { ::close(s); }
+#endif
 
-  // Format:
-  // pad key type jid code dir threshold
-  for (int p = 0; p < 2; ++p) {
-    for (int k = 0; k < (int)VKey::Count; ++k) {
-      const Binding& b = gPad[p].bind[k];
-      std::fprintf(fp, "%d %d %d %d %d %d %.6f\n",
-        p, k,
-        (int)b.type,
-        b.jid,
-        b.code,
-        b.dir,
-        b.threshold
-      );
+static bool netInit() {
+#ifdef _WIN32
+  static bool done = false;
+  if (!done) {
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+      std::fprintf(stderr, "[net] WSAStartup failed\n");
+      return false;
     }
+    done = true;
   }
+#endif
+  return true;
+}
 
-  std::fclose(fp);
+// "host:port", "[v6]:port" or just "port" (host defaults to `defHost`).
+static bool resolveUdp(const char* spec, const char* defHost, bool passive, sockaddr_storage& out, socklen_t& outLen) {
+  std::string host = defHost ? defHost : "";
+  std::string port = spec;
+  const char* colon = std::strrchr(spec, ':');
+  if (colon) {
+    host.assign(spec, (size_t)(colon - spec));
+    port = colon + 1;
+    if (host.size() >= 2 && host.front() == '[' && host.back() == ']') host = host.substr(1, host.size() - 2);
+  }
+
+  addrinfo hints;
+  std::memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_DGRAM;
+  hints.ai_protocol = IPPROTO_UDP;
+  if (passive) hints.ai_flags = AI_PASSIVE;
+  addrinfo* res = nullptr;
+  if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &res) != 0 || !res) {
+    std::fprintf(stderr, "[net] cannot resolve %s\n", spec);
+    return false;
+  }
+  std::memcpy(&out, res->ai_addr, res->ai_addrlen);
+  outLen = (socklen_t)res->ai_addrlen;
+  freeaddrinfo(res);
   return true;
 }
 
-static bool loadMappings() {
-  std::FILE* fp = std::fopen(kMapFile, "rb");
-  if (!fp) return false;
+class UdpPadSender {
+ public:
+  ~UdpPadSender() { close(); }
 
-  // Initialize to None first
-  for (int p = 0; p < 2; ++p) {
-    for (int k = 0; k < (int)VKey::Count; ++k) {
-      gPad[p].bind[k] = Binding{};
+  bool open(const char* spec, int padCount) {
+    close();
+    if (!netInit() || !resolveUdp(spec, nullptr, false, addr_, addrLen_)) return false;
+    sock_ = socket(addr_.ss_family, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock_ == kNoSocket) {
+      std::fprintf(stderr, "[net] socket() failed\n");
+      return false;
     }
+    // Expedited forwarding; ignored where not permitted.
+    int tos = 0xB8;
+    setsockopt(sock_, IPPROTO_IP, IP_TOS, (const char*)&tos, sizeof(tos));
+
+    padCount_ = padCount;
+    session_ = (uint32_t)(nowNs() ^ (nowNs() >> 32));
+    seq_ = 0;
+    repeats_ = 0;
+    lastSendNs_ = 0;
+    std::memset(last_, 0xFF, sizeof(last_));
+    std::fprintf(stderr, "[net] sending %d pad(s) to %s (session %08x)\n", padCount, spec, session_);
+    return true;
   }
 
-  int p = 0, k = 0, type = 0, jid = 0, code = 0, dir = 0;
-  float th = 0.45f;
+  bool isOpen() const { return sock_ != kNoSocket; }
+
+  bool changed(const uint8_t* bits6) const { return std::memcmp(bits6, last_, (size_t)padCount_) != 0; }
+  const uint8_t* last() const { return last_; }
+  bool repeatsPending() const { return repeats_ > 0; }
+
+  // Sends a changed state right away, else a pending repeat or a due
+  // keepalive. Returns the bytes sent, or -1 on error.
+  int update(const uint8_t* bits6, uint64_t tNs) {
+    if (sock_ == kNoSocket) return -1;
+    if (changed(bits6)) {
+      std::memcpy(last_, bits6, (size_t)padCount_);
+      ++seq_;
+      repeats_ = kUdpRepeats;
+      return send(tNs);
+    }
+    if (repeats_ > 0) {
+      --repeats_;
+      return send(tNs);
+    }
+    if (tNs - lastSendNs_ >= (uint64_t)kUdpKeepaliveMs * 1000000ull) return send(tNs);
+    return 0;
+  }
 
-  while (true) {
-    int r = std::fscanf(fp, "%d %d %d %d %d %d %f", &p, &k, &type, &jid, &code, &dir, &th);
-    if (r != 7) break;
-    if (p < 0 || p >= 2) continue;
-    if (k < 0 || k >= (int)VKey::Count) continue;
+  void close() {
+    if (sock_ == kNoSocket) return;
+    closeSocket(sock_);
+    sock_ = kNoSocket;
+    std::fprintf(stderr, "[net] sender closed: %llu datagrams, %llu errors, last seq %u\n",
+      (unsigned long long)sent_, (unsigned long long)errors_, seq_);
+  }
 
-    Binding b;
-    b.type = (BindType)type;
-    b.jid = jid;
-    b.code = code;
-    b.dir = dir;
-    b.threshold = th;
-    gPad[p].bind[k] = b;
+ private:
+  int send(uint64_t tNs) {
+    uint8_t pkt[kUdpHeaderSize + kMaxPads];
+    pkt[0] = 'U';
+    pkt[1] = '2';
+    pkt[2] = kUdpVersion;
+    pkt[3] = (uint8_t)padCount_;
+    for (int i = 0; i < 4; ++i) {
+      pkt[4 + i] = (uint8_t)(session_ >> (8 * i));
+      pkt[8 + i] = (uint8_t)(seq_ >> (8 * i));
+    }
+    std::memcpy(pkt + kUdpHeaderSize, last_, (size_t)padCount_);
+    const int n = (int)(kUdpHeaderSize + (size_t)padCount_);
+    lastSendNs_ = tNs;
+    if (sendto(sock_, (const char*)pkt, n, 0, (const sockaddr*)&addr_, addrLen_) != n) {
+      ++errors_;
+      return -1;
+    }
+    ++sent_;
+    return n;
   }
 
-  std::fclose(fp);
-  return true;
+  SocketHandle sock_ = kNoSocket;
+  sockaddr_storage addr_{};
+  socklen_t addrLen_ = 0;
+  int padCount_ = 0;
+  uint32_t session_ = 0;
+  uint32_t seq_ = 0;
+  int repeats_ = 0;
+  uint64_t lastSendNs_ = 0;
+  uint8_t last_[kMaxPads];
+  uint64_t sent_ = 0;
+  uint64_t errors_ = 0;
+};
+
+// The writer thread owns the sender; repeats and keepalives go out from poll().
+class UdpBackend : public OutputBackend {
+ public:
+  bool open(const OutputTarget& t) override { return sender_.open(t.serial.c_str(), t.pads); }
+  void close() override { sender_.close(); }
+  bool needsWrite(const uint8_t* bits6) const override { return sender_.changed(bits6); }
+  int writePads(const uint8_t* bits6) override { return sender_.update(bits6, nowNs()); }
+  int poll(uint64_t tNs) override { return sender_.update(sender_.last(), tNs); }
+  int pollMs() const override { return sender_.repeatsPending() ? 1 : kUdpKeepaliveMs; }
+
+ private:
+  UdpPadSender sender_;
+};
+
+static std::unique_ptr<OutputBackend> makeOutputBackend(const OutputTarget& t) {
+  switch (t.kind) {
+    case OutputKind::Uart: return std::unique_ptr<OutputBackend>(new UartBackend());
+    case OutputKind::Null: return std::unique_ptr<OutputBackend>(new NullBackend());
+    case OutputKind::Udp: return std::unique_ptr<OutputBackend>(new UdpBackend());
+    default: return std::unique_ptr<OutputBackend>(new Ft245Backend());
+  }
 }
 
 // -----------------------------------------------------------------------------
@@ -725,133 +4856,881 @@ static void drawRect(float x0, float y0, float x1, float y1, bool filled) {
   }
 }
 
-static void drawCircle(float cx, float cy, float r, bool filled) {
-  const int seg = 32;
-  if (filled) glBegin(GL_TRIANGLE_FAN);
-  else glBegin(GL_LINE_LOOP);
+// -----------------------------------------------------------------------------
+// Buffer objects (GL 1.5), loaded through GLFW so no extension loader is
+// needed. Render thread only; gGlVbo stays false on contexts without them and
+// callers fall back to client-side vertex arrays.
+// -----------------------------------------------------------------------------
+#ifndef GL_ARRAY_BUFFER
+  #define GL_ARRAY_BUFFER 0x8892
+#endif
+#ifndef GL_STATIC_DRAW
+  #define GL_STATIC_DRAW 0x88E4
+#endif
+#ifndef APIENTRY
+  #define APIENTRY
+#endif
 
-  if (filled) glVertex2f(cx, cy);
-  for (int i = 0; i <= seg; ++i) {
-    float a = (float)i / (float)seg * 6.2831853f;
-    float x = cx + std::cos(a) * r;
-    float y = cy + std::sin(a) * r;
-    glVertex2f(x, y);
-  }
-  glEnd();
+typedef void (APIENTRY* GlGenBuffersFn)(GLsizei, GLuint*);
+typedef void (APIENTRY* GlDeleteBuffersFn)(GLsizei, const GLuint*);
+typedef void (APIENTRY* GlBindBufferFn)(GLenum, GLuint);
+typedef void (APIENTRY* GlBufferDataFn)(GLenum, std::ptrdiff_t, const void*, GLenum);
+
+static bool gGlVbo = false;
+static GlGenBuffersFn gGlGenBuffers = nullptr;
+static GlDeleteBuffersFn gGlDeleteBuffers = nullptr;
+static GlBindBufferFn gGlBindBuffer = nullptr;
+static GlBufferDataFn gGlBufferData = nullptr;
+
+// Call once with the context current.
+static void loadGlBufferObjects() {
+  gGlGenBuffers = (GlGenBuffersFn)glfwGetProcAddress("glGenBuffers");
+  gGlDeleteBuffers = (GlDeleteBuffersFn)glfwGetProcAddress("glDeleteBuffers");
+  gGlBindBuffer = (GlBindBufferFn)glfwGetProcAddress("glBindBuffer");
+  gGlBufferData = (GlBufferDataFn)glfwGetProcAddress("glBufferData");
+  gGlVbo = gGlGenBuffers && gGlDeleteBuffers && gGlBindBuffer && gGlBufferData;
+  std::fprintf(stderr, "[gl] vertex buffer objects %s\n", gGlVbo ? "available" : "unavailable (client arrays)");
 }
 
+// -----------------------------------------------------------------------------
+// Text geometry cache
+// - drawText() looks (text, x, y) up and draws the stored vertices; only a
+//   miss runs stb_easy_font_print and the y-flip. Vertices are kept as plain
+//   x,y pairs (already flipped), in a VBO when available.
+// - Entries not drawn during a frame are dropped by endFrame(), so changing
+//   text (pad titles, overlay) does not accumulate. A framebuffer height change
+//   invalidates everything (the flip depends on it).
+// - Render thread only.
+// -----------------------------------------------------------------------------
+class TextCache {
+ public:
+  void draw(float x, float y, const char* s, int fbh) {
+    if (fbh != fbh_) {
+      clear();
+      fbh_ = fbh;
+    }
+    const size_t len = std::strlen(s);
+    const uint64_t key = hash(x, y, s, len);
+    auto it = map_.find(key);
+    if (it == map_.end() || it->second.text.compare(0, std::string::npos, s, len) != 0 ||
+        it->second.x != x || it->second.y != y) {
+      if (it != map_.end()) release(it->second);
+      it = map_.insert_or_assign(key, build(x, y, s, len)).first;
+    }
+    Entry& e = it->second;
+    e.frame = frame_;
+    if (!e.verts) return;
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    if (e.vbo) {
+      gGlBindBuffer(GL_ARRAY_BUFFER, e.vbo);
+      glVertexPointer(2, GL_FLOAT, 0, nullptr);
+    } else {
+      glVertexPointer(2, GL_FLOAT, 0, e.xy.data());
+    }
+    glDrawArrays(GL_QUADS, 0, e.verts);
+    if (e.vbo) gGlBindBuffer(GL_ARRAY_BUFFER, 0);
+    glDisableClientState(GL_VERTEX_ARRAY);
+  }
+
+  void endFrame() {
+    for (auto it = map_.begin(); it != map_.end();) {
+      if (it->second.frame != frame_) {
+        release(it->second);
+        it = map_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    ++frame_;
+  }
+
+  void clear() {
+    for (auto& kv : map_) release(kv.second);
+    map_.clear();
+  }
+
+ private:
+  struct Entry {
+    std::string text;
+    float x = 0.0f, y = 0.0f;
+    int verts = 0;
+    GLuint vbo = 0;
+    std::vector<float> xy;     // client-array fallback
+    uint32_t frame = 0;
+  };
+
+  static uint64_t hash(float x, float y, const char* s, size_t len) {
+    uint64_t h = 1469598103934665603ull;  // FNV-1a
+    auto mix = [&h](const void* p, size_t n) {
+      const unsigned char* b = (const unsigned char*)p;
+      for (size_t i = 0; i < n; ++i) { h ^= b[i]; h *= 1099511628211ull; }
+    };
+    mix(&x, sizeof(x));
+    mix(&y, sizeof(y));
+    mix(s, len);
+    return h;
+  }
+
+  Entry build(float x, float y, const char* s, size_t len) {
+    Entry e;
+    e.text.assign(s, len);
+    e.x = x;
+    e.y = y;
+
+    // stb_easy_font expects y to increase downward. We render with y-up coordinates,
+    // so we flip y around the framebuffer height after generating the vertices.
+    const float y_down = (float)fbh_ - y;
+
+    // NOTE:
+    // Avoid `static alignas(16)` here because some GCC setups treat attributes
+    // in the middle of decl-specifiers as an error. Alignment is not required
+    // for stb_easy_font.
+    static unsigned char vbuf[64 * 1024];
+    int quads = stb_easy_font_print(x, y_down, (char*)e.text.c_str(), nullptr, vbuf, (int)sizeof(vbuf));
+    e.verts = quads * 4;
+
+    // Compact to x,y and flip Y without assuming float alignment.
+    e.xy.resize((size_t)e.verts * 2);
+    for (int i = 0; i < e.verts; ++i) {
+      float px = 0.0f, py = 0.0f;
+      std::memcpy(&px, vbuf + i * 16, sizeof(float));
+      std::memcpy(&py, vbuf + i * 16 + 4, sizeof(float));
+      e.xy[(size_t)i * 2] = px;
+      e.xy[(size_t)i * 2 + 1] = (float)fbh_ - py;
+    }
+
+    if (gGlVbo && e.verts) {
+      gGlGenBuffers(1, &e.vbo);
+      gGlBindBuffer(GL_ARRAY_BUFFER, e.vbo);
+      gGlBufferData(GL_ARRAY_BUFFER, (std::ptrdiff_t)(e.xy.size() * sizeof(float)), e.xy.data(), GL_STATIC_DRAW);
+      gGlBindBuffer(GL_ARRAY_BUFFER, 0);
+      std::vector<float>().swap(e.xy);
+    }
+    return e;
+  }
+
+  static void release(Entry& e) {
+    if (e.vbo) gGlDeleteBuffers(1, &e.vbo);
+    e.vbo = 0;
+  }
+
+  std::unordered_map<uint64_t, Entry> map_;
+  int fbh_ = -1;
+  uint32_t frame_ = 1;
+};
+
+static TextCache gTextCache;
+
 static void drawText(float x, float y, const char* s, unsigned char r=255, unsigned char g=255, unsigned char b=255, unsigned char a=255) {
   if (!s || !*s) return;
+  glColor4ub(r, g, b, a);
+  gTextCache.draw(x, y, s, gFBH);
+}
+
+// -----------------------------------------------------------------------------
+// Pad diagram labels
+// - The "Up: Key(87)" style labels only change with the bindings, the title
+//   only with the pad state / edit focus. Rebuilt on change, not per frame.
+// - Render thread only.
+// -----------------------------------------------------------------------------
+static bool sameBinding(const Binding& a, const Binding& b) {
+  return a.type == b.type && a.jid == b.jid && a.code == b.code && a.dir == b.dir && a.threshold == b.threshold;
+}
+
+struct PadLabels {
+  Binding bind[(int)VKey::Count];
+  char label[(int)VKey::Count][96] = {};
+  bool valid = false;
+
+  uint8_t titleBits = 0xFFu;
+  bool titleSelected = false;
+  char title[64] = {};
+
+  void update(const VirtualPad& pad, int padIndex, uint8_t bits6, bool selected) {
+    static const char* kNames[(int)VKey::Count] = {"Up", "Down", "Left", "Right", "B1", "B2"};
+    for (int k = 0; k < (int)VKey::Count; ++k) {
+      if (valid && sameBinding(bind[k], pad.bind[k])) continue;
+      bind[k] = pad.bind[k];
+      const int n = std::snprintf(label[k], sizeof(label[k]), "%s: ", kNames[k]);
+      bind[k].format(label[k] + n, sizeof(label[k]) - (size_t)n);
+    }
+    valid = true;
+
+    if (titleBits != bits6 || titleSelected != selected || !title[0]) {
+      std::snprintf(title, sizeof(title), "VPad%d  bits=0x%02X  %s", padIndex + 1, (unsigned)(~bits6 & 0x3Fu), selected ? "[EDIT]" : "");
+      titleBits = bits6;
+      titleSelected = selected;
+    }
+  }
+};
+
+static PadLabels gPadLabels[kMaxPads];
+
+
+// -----------------------------------------------------------------------------
+// Pad diagram geometry
+// - Body, D-pad and button shapes are built once per pad rectangle (i.e. on
+//   resize or pad count change) into two retained arrays: filled triangles with
+//   a per-vertex color, and outline lines. Positions live in VBOs when
+//   available.
+// - Per frame only the fill colors of elements whose highlight changed are
+//   rewritten; each pad is one GL_TRIANGLES and one GL_LINES draw call.
+// - Render thread only.
+// -----------------------------------------------------------------------------
+static constexpr int kCircleSegments = 32;
+
+static const float* unitCircle() {
+  static float xy[(kCircleSegments + 1) * 2];
+  static bool init = false;
+  if (!init) {
+    for (int i = 0; i <= kCircleSegments; ++i) {
+      float a = (float)i / (float)kCircleSegments * 6.2831853f;
+      xy[i * 2] = std::cos(a);
+      xy[i * 2 + 1] = std::sin(a);
+    }
+    init = true;
+  }
+  return xy;
+}
+
+class PadGeometry {
+ public:
+  // Elements: body, then one per VKey in VKey order.
+  static constexpr int kBody = 0;
+  static constexpr int kElems = 1 + (int)VKey::Count;
+
+  float labelX[(int)VKey::Count] = {};
+  float labelY[(int)VKey::Count] = {};
+
+  void update(float x, float y, float w, float h, uint8_t bits6) {
+    if (!valid_ || x != x_ || y != y_ || w != w_ || h != h_) build(x, y, w, h, bits6);
+    else if (bits6 != colorBits_) setColors(bits6);
+  }
+
+  void draw() const {
+    glEnableClientState(GL_VERTEX_ARRAY);
+
+    glEnableClientState(GL_COLOR_ARRAY);
+    bindPositions(fillVbo_, fill_);
+    glColorPointer(4, GL_UNSIGNED_BYTE, 0, rgba_.data());
+    glDrawArrays(GL_TRIANGLES, 0, (GLsizei)(fillVerts_));
+    glDisableClientState(GL_COLOR_ARRAY);
+
+    glColor3f(0.2f, 0.2f, 0.25f);
+    bindPositions(lineVbo_, line_);
+    glDrawArrays(GL_LINES, 0, (GLsizei)(lineVerts_));
+
+    if (gGlVbo) gGlBindBuffer(GL_ARRAY_BUFFER, 0);
+    glDisableClientState(GL_VERTEX_ARRAY);
+  }
+
+  void release() {
+    if (fillVbo_) gGlDeleteBuffers(1, &fillVbo_);
+    if (lineVbo_) gGlDeleteBuffers(1, &lineVbo_);
+    fillVbo_ = lineVbo_ = 0;
+    valid_ = false;
+  }
+
+ private:
+  void bindPositions(GLuint vbo, const std::vector<float>& xy) const {
+    if (vbo) {
+      gGlBindBuffer(GL_ARRAY_BUFFER, vbo);
+      glVertexPointer(2, GL_FLOAT, 0, nullptr);
+    } else {
+      if (gGlVbo) gGlBindBuffer(GL_ARRAY_BUFFER, 0);
+      glVertexPointer(2, GL_FLOAT, 0, xy.data());
+    }
+  }
+
+  void rect(int elem, float x0, float y0, float x1, float y1) {
+    first_[elem] = (int)fill_.size() / 2;
+    const float t[12] = {x0, y0, x1, y0, x1, y1, x0, y0, x1, y1, x0, y1};
+    fill_.insert(fill_.end(), t, t + 12);
+    count_[elem] = 6;
+    const float l[16] = {x0, y0, x1, y0, x1, y0, x1, y1, x1, y1, x0, y1, x0, y1, x0, y0};
+    line_.insert(line_.end(), l, l + 16);
+  }
+
+  void circle(int elem, float cx, float cy, float r) {
+    const float* u = unitCircle();
+    first_[elem] = (int)fill_.size() / 2;
+    for (int i = 0; i < kCircleSegments; ++i) {
+      const float t[6] = {cx, cy,
+        cx + u[i * 2] * r, cy + u[i * 2 + 1] * r,
+        cx + u[i * 2 + 2] * r, cy + u[i * 2 + 3] * r};
+      fill_.insert(fill_.end(), t, t + 6);
+      const float l[4] = {t[2], t[3], t[4], t[5]};
+      line_.insert(line_.end(), l, l + 4);
+    }
+    count_[elem] = kCircleSegments * 3;
+  }
+
+  void build(float x, float y, float w, float h, uint8_t bits6) {
+    x_ = x; y_ = y; w_ = w; h_ = h;
+    fill_.clear();
+    line_.clear();
+
+    rect(kBody, x, y, x + w, y + h);
+
+    // D-pad area
+    const float dpx = x + w * 0.20f;
+    const float dpy = y + h * 0.50f;
+    const float dsz = (std::min)(w, h) * 0.18f;
+    auto dir = [&](VKey k, float cx, float cy, float ww, float hh) {
+      rect(1 + (int)k, cx - ww*0.5f, cy - hh*0.5f, cx + ww*0.5f, cy + hh*0.5f);
+      labelX[(int)k] = cx + ww*0.6f;
+      labelY[(int)k] = cy - 6;
+    };
+    dir(VKey::Up, dpx, dpy + dsz, dsz * 0.8f, dsz * 0.6f);
+    dir(VKey::Down, dpx, dpy - dsz, dsz * 0.8f, dsz * 0.6f);
+    dir(VKey::Left, dpx - dsz, dpy, dsz * 0.6f, dsz * 0.8f);
+    dir(VKey::Right, dpx + dsz, dpy, dsz * 0.6f, dsz * 0.8f);
+
+    // Buttons area
+    const float bx = x + w * 0.70f;
+    const float by = y + h * 0.55f;
+    const float br = (std::min)(w, h) * 0.06f;
+    auto btn = [&](VKey k, float cx, float cy) {
+      circle(1 + (int)k, cx, cy, br);
+      labelX[(int)k] = cx + br * 1.5f;
+      labelY[(int)k] = cy - 6;
+    };
+    btn(VKey::B1, bx, by + br * 2.0f);
+    btn(VKey::B2, bx, by - br * 2.0f);
+
+    fillVerts_ = (int)fill_.size() / 2;
+    lineVerts_ = (int)line_.size() / 2;
+    rgba_.assign((size_t)fillVerts_ * 4, 0);
+    paint(kBody, 204, 204, 217);
+    colorBits_ = (uint8_t)~bits6;   // force every element below
+    setColors(bits6);
+
+    if (gGlVbo) {
+      if (!fillVbo_) gGlGenBuffers(1, &fillVbo_);
+      if (!lineVbo_) gGlGenBuffers(1, &lineVbo_);
+      gGlBindBuffer(GL_ARRAY_BUFFER, fillVbo_);
+      gGlBufferData(GL_ARRAY_BUFFER, (std::ptrdiff_t)(fill_.size() * sizeof(float)), fill_.data(), GL_STATIC_DRAW);
+      gGlBindBuffer(GL_ARRAY_BUFFER, lineVbo_);
+      gGlBufferData(GL_ARRAY_BUFFER, (std::ptrdiff_t)(line_.size() * sizeof(float)), line_.data(), GL_STATIC_DRAW);
+      gGlBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    valid_ = true;
+  }
+
+  void paint(int elem, uint8_t r, uint8_t g, uint8_t b) {
+    uint8_t* c = rgba_.data() + (size_t)first_[elem] * 4;
+    for (int i = 0; i < count_[elem]; ++i, c += 4) {
+      c[0] = r; c[1] = g; c[2] = b; c[3] = 255;
+    }
+  }
+
+  // bits6 is active-low (as written to the FT245): a cleared bit is pressed.
+  void setColors(uint8_t bits6) {
+    const uint8_t changed = (uint8_t)(bits6 ^ colorBits_);
+    for (int k = 0; k < (int)VKey::Count; ++k) {
+      if (!(changed & (1u << k))) continue;
+      const bool on = ((bits6 >> k) & 1u) == 0;
+      const bool isDir = k <= (int)VKey::Right;
+      if (isDir) {
+        if (on) paint(1 + k, 51, 204, 77);
+        else paint(1 + k, 153, 153, 153);
+      } else {
+        if (on) paint(1 + k, 230, 77, 51);
+        else paint(1 + k, 191, 191, 191);
+      }
+    }
+    colorBits_ = bits6;
+  }
+
+  bool valid_ = false;
+  float x_ = 0, y_ = 0, w_ = 0, h_ = 0;
+  std::vector<float> fill_;      // GL_TRIANGLES, x,y
+  std::vector<float> line_;      // GL_LINES, x,y
+  std::vector<uint8_t> rgba_;    // per fill vertex
+  int fillVerts_ = 0;
+  int lineVerts_ = 0;
+  int first_[kElems] = {};
+  int count_[kElems] = {};
+  uint8_t colorBits_ = 0x3Fu;
+  GLuint fillVbo_ = 0;
+  GLuint lineVbo_ = 0;
+};
 
-  // stb_easy_font expects y to increase downward. We render with y-up coordinates,
-  // so we flip y around the framebuffer height after generating the vertices.
-  const float y_down = (float)gFBH - y;
+static PadGeometry gPadGeom[kMaxPads];
 
-  // NOTE:
-  // Avoid `static alignas(16)` here because some GCC setups treat attributes
-  // in the middle of decl-specifiers as an error. Alignment is not required
-  // for stb_easy_font.
-  static unsigned char vbuf[64 * 1024];
-  int quads = stb_easy_font_print(x, y_down, (char*)s, nullptr, vbuf, (int)sizeof(vbuf));
-  const int verts = quads * 4;
+static void drawPadDiagram(float x, float y, float w, float h, uint8_t bits6, const VirtualPad& pad, int padIndex, bool selected) {
+  TRACE_ZONE("drawPadDiagram");
+  PadGeometry& geom = gPadGeom[padIndex];
+  geom.update(x, y, w, h, bits6);
+  geom.draw();
 
-  // Flip Y safely without assuming float alignment or violating strict aliasing.
-  for (int i = 0; i < verts; ++i) {
-    float py = 0.0f;
-    std::memcpy(&py, vbuf + i * 16 + 4, sizeof(float));
-    py = (float)gFBH - py;
-    std::memcpy(vbuf + i * 16 + 4, &py, sizeof(float));
+  // Title and binding labels
+  PadLabels& labels = gPadLabels[padIndex];
+  labels.update(pad, padIndex, bits6, selected);
+  drawText(x + 10, y + h - 20, labels.title, 10, 10, 10, 255);
+  for (int k = 0; k < (int)VKey::Count; ++k) {
+    drawText(geom.labelX[k], geom.labelY[k], labels.label[k], 20, 20, 20, 255);
   }
 
-  glColor4ub(r, g, b, a);
-  glEnableClientState(GL_VERTEX_ARRAY);
-  glVertexPointer(2, GL_FLOAT, 16, vbuf);
-  glDrawArrays(GL_QUADS, 0, verts);
-  glDisableClientState(GL_VERTEX_ARRAY);
+  // Edit focus highlight
+  if (selected) {
+    glColor3f(0.1f, 0.4f, 1.0f);
+    glLineWidth(3.0f);
+    drawRect(x + 2, y + 2, x + w - 2, y + h - 2, false);
+    glLineWidth(1.0f);
+  }
 }
 
+// -----------------------------------------------------------------------------
+// Telemetry (F4 panel, --stats-file)
+// - A sampler thread wakes every --stats-interval ms, turns the running
+//   counters into rates over that window and publishes a TelemetrySample
+//   through gTelemetry for the F4 panel. With --stats-file it also appends
+//   one line per sample, JSON lines or CSV (--stats-format), for monitoring.
+// - The hot paths only bump relaxed atomics (gIoCounters); the latency
+//   histograms stay with their threads.
+// - Per output: writes/s, bytes/s, device RX/TX queue (FT_GetStatus, sampled
+//   by the writer every 100 ms), write failures, coalesced and dropped states.
+//   gFtErrors counts every failed D2XX call (ftOk).
+// -----------------------------------------------------------------------------
+struct IoCounters {
+  std::atomic<uint64_t> ticks{0};
+  std::atomic<uint64_t> jitterSumNs{0};
+  std::atomic<uint64_t> jitterMaxNs{0};    // since the last sample
+  std::atomic<uint64_t> frames{0};         // render thread
+  std::atomic<uint64_t> frameSumNs{0};
+  std::atomic<uint64_t> frameMaxNs{0};     // since the last sample
+};
 
-static void drawPadDiagram(float x, float y, float w, float h, const Digital6& st, const VirtualPad& pad, int padIndex, bool selected) {
-  // Body
-  glColor3f(0.8f, 0.8f, 0.85f);
-  drawRect(x, y, x + w, y + h, true);
+static IoCounters gIoCounters;
+
+static constexpr int kMaxTelemetryOutputs = 8;
+
+struct TelemetryOutput {
+  char name[48] = {};
+  const char* mode = "";
+  int firstPad = 0;
+  int pads = 0;
+  bool connected = false;
+  uint64_t reconnects = 0;
+  double writesPerSec = 0.0;
+  double bytesPerSec = 0.0;
+  bool queueKnown = false;
+  uint32_t rxQueue = 0;
+  uint32_t txQueue = 0;
+  uint64_t failures = 0;
+  uint64_t coalesced = 0;
+  uint64_t dropped = 0;
+};
 
-  glColor3f(0.2f, 0.2f, 0.25f);
-  drawRect(x, y, x + w, y + h, false);
+struct TelemetrySample {
+  double tSec = 0.0;           // since telemetry start
+  double pollHz = 0.0;
+  double jitterMeanUs = 0.0;
+  double jitterMaxUs = 0.0;
+  double uiFps = 0.0;
+  double frameMeanMs = 0.0;    // draw + swap
+  double frameMaxMs = 0.0;
+  uint64_t ftErrors = 0;
+  bool vsync = false;          // --vsync given
+  double vsyncHz = 0.0;        // 0 = not locked
+  double vsyncErrUs = 0.0;     // last edge vs. prediction
+  int outputCount = 0;
+  TelemetryOutput out[kMaxTelemetryOutputs];
+};
 
-  // Title
-  char title[256];
-  std::snprintf(title, sizeof(title), "VPad%d  bits=0x%02X  %s", padIndex + 1, st.packBits(), selected ? "[EDIT]" : "");
-  drawText(x + 10, y + h - 20, title, 10, 10, 10, 255);
+static TripleBuffer<TelemetrySample> gTelemetry;   // sampler -> render thread
+static std::atomic<bool> gStatsPanel{false};       // F4
 
-  // D-pad area
-  float dpx = x + w * 0.20f;
-  float dpy = y + h * 0.50f;
-  float dsz = (std::min)(w, h) * 0.18f;
+static void requestUiRedraw();
 
-  auto drawDir = [&](float cx, float cy, float ww, float hh, bool on, const char* label, const char* bindStr) {
-    if (on) glColor3f(0.2f, 0.8f, 0.3f);
-    else glColor3f(0.6f, 0.6f, 0.6f);
-    drawRect(cx - ww*0.5f, cy - hh*0.5f, cx + ww*0.5f, cy + hh*0.5f, true);
+enum class StatsFormat {
+  Json = 0,
+  Csv
+};
 
-    glColor3f(0.2f, 0.2f, 0.25f);
-    drawRect(cx - ww*0.5f, cy - hh*0.5f, cx + ww*0.5f, cy + hh*0.5f, false);
+class TelemetrySampler {
+ public:
+  ~TelemetrySampler() { stop(); }
+
+  // path may be empty (panel only) or "-" (stdout).
+  bool start(const std::string& path, StatsFormat format, int intervalMs) {
+    format_ = format;
+    intervalMs_ = intervalMs;
+    if (!path.empty()) {
+      fp_ = path == "-" ? stdout : std::fopen(path.c_str(), "w");
+      if (!fp_) {
+        std::fprintf(stderr, "[stats] cannot open %s\n", path.c_str());
+        return false;
+      }
+      if (format_ == StatsFormat::Csv) {
+        std::fprintf(fp_, "t,poll_hz,jitter_mean_us,jitter_max_us,ui_fps,frame_mean_ms,frame_max_ms,ft_errors,vsync_hz,"
+          "output,mode,pads,connected,reconnects,writes_hz,bytes_s,rx_queue,tx_queue,failures,coalesced,dropped\n");
+        std::fflush(fp_);
+      }
+    }
+    stop_ = false;
+    th_ = std::thread(&TelemetrySampler::run, this);
+    return true;
+  }
+
+  void stop() {
+    {
+      std::lock_guard<std::mutex> lock(m_);
+      stop_ = true;
+    }
+    cv_.notify_one();
+    if (th_.joinable()) th_.join();
+    if (fp_ && fp_ != stdout) std::fclose(fp_);
+    fp_ = nullptr;
+  }
 
-    char t[256];
-    std::snprintf(t, sizeof(t), "%s: %s", label, bindStr);
-    drawText(cx + ww*0.6f, cy - 6, t, 20, 20, 20, 255);
+ private:
+  struct Prev {
+    uint64_t written = 0;
+    uint64_t bytes = 0;
   };
 
-  drawDir(dpx, dpy + dsz, dsz * 0.8f, dsz * 0.6f, st.up, "Up", pad.bind[(int)VKey::Up].toString().c_str());
-  drawDir(dpx, dpy - dsz, dsz * 0.8f, dsz * 0.6f, st.down, "Down", pad.bind[(int)VKey::Down].toString().c_str());
-  drawDir(dpx - dsz, dpy, dsz * 0.6f, dsz * 0.8f, st.left, "Left", pad.bind[(int)VKey::Left].toString().c_str());
-  drawDir(dpx + dsz, dpy, dsz * 0.6f, dsz * 0.8f, st.right, "Right", pad.bind[(int)VKey::Right].toString().c_str());
+  void run() {
+    const uint64_t t0 = nowNs();
+    uint64_t tPrev = t0, ticksPrev = 0, jitterPrev = 0, framesPrev = 0, frameSumPrev = 0;
+    Prev prev[kMaxTelemetryOutputs];
+
+    std::unique_lock<std::mutex> lock(m_);
+    while (!stop_) {
+      cv_.wait_for(lock, std::chrono::milliseconds(intervalMs_));
+      if (stop_) break;
+
+      const uint64_t now = nowNs();
+      const double dt = (double)(now - tPrev) / 1e9;
+      tPrev = now;
+
+      TelemetrySample& t = gTelemetry.writeBuffer();
+      t.tSec = (double)(now - t0) / 1e9;
+
+      const uint64_t ticks = gIoCounters.ticks.load(std::memory_order_relaxed);
+      const uint64_t jitter = gIoCounters.jitterSumNs.load(std::memory_order_relaxed);
+      t.pollHz = (double)(ticks - ticksPrev) / dt;
+      t.jitterMeanUs = ticks > ticksPrev ? (double)(jitter - jitterPrev) / (double)(ticks - ticksPrev) / 1000.0 : 0.0;
+      t.jitterMaxUs = (double)gIoCounters.jitterMaxNs.exchange(0, std::memory_order_relaxed) / 1000.0;
+      ticksPrev = ticks;
+      jitterPrev = jitter;
+
+      const uint64_t frames = gIoCounters.frames.load(std::memory_order_relaxed);
+      const uint64_t frameSum = gIoCounters.frameSumNs.load(std::memory_order_relaxed);
+      t.uiFps = (double)(frames - framesPrev) / dt;
+      t.frameMeanMs = frames > framesPrev ? (double)(frameSum - frameSumPrev) / (double)(frames - framesPrev) / 1e6 : 0.0;
+      t.frameMaxMs = (double)gIoCounters.frameMaxNs.exchange(0, std::memory_order_relaxed) / 1e6;
+      framesPrev = frames;
+      frameSumPrev = frameSum;
+
+      t.ftErrors = gFtErrors.load(std::memory_order_relaxed);
+      t.vsync = gVsync.enabled();
+      t.vsyncHz = gVsync.lockedHz();
+      t.vsyncErrUs = gVsync.lastErrUs();
+
+      // gWriters is fixed while the sampler runs (started after, stopped before).
+      t.outputCount = (std::min)((int)gWriters.size(), kMaxTelemetryOutputs);
+      for (int i = 0; i < t.outputCount; ++i) {
+        const OutputWriter& wr = *gWriters[(size_t)i];
+        OutputWriterCounters c;
+        wr.counters(c);
+        TelemetryOutput& o = t.out[i];
+        std::snprintf(o.name, sizeof(o.name), "%s", wr.target().serial.c_str());
+        o.mode = outputTargetMode(wr.target());
+        o.firstPad = wr.target().firstPad;
+        o.pads = wr.padCount();
+        o.connected = c.connected;
+        o.reconnects = c.reconnects;
+        o.writesPerSec = (double)(c.written - prev[i].written) / dt;
+        o.bytesPerSec = (double)(c.bytes - prev[i].bytes) / dt;
+        o.queueKnown = c.queueKnown;
+        o.rxQueue = c.rxQueue;
+        o.txQueue = c.txQueue;
+        o.failures = c.failures;
+        o.coalesced = c.coalesced;
+        o.dropped = c.dropped;
+        prev[i].written = c.written;
+        prev[i].bytes = c.bytes;
+      }
+
+      if (fp_) writeLine(t);
+      gTelemetry.publish();
+      if (gStatsPanel.load(std::memory_order_relaxed)) requestUiRedraw();
+    }
+  }
+
+  void writeLine(const TelemetrySample& t) {
+    if (format_ == StatsFormat::Csv) {
+      // One row per output; with no outputs, one row with empty output columns.
+      for (int i = 0; i < (std::max)(t.outputCount, 1); ++i) {
+        std::fprintf(fp_, "%.3f,%.1f,%.1f,%.1f,%.1f,%.2f,%.2f,%llu,",
+          t.tSec, t.pollHz, t.jitterMeanUs, t.jitterMaxUs, t.uiFps, t.frameMeanMs, t.frameMaxMs,
+          (unsigned long long)t.ftErrors);
+        if (t.vsyncHz > 0.0) std::fprintf(fp_, "%.3f,", t.vsyncHz);
+        else std::fprintf(fp_, ",");
+        if (i >= t.outputCount) {
+          std::fprintf(fp_, ",,,,,,,,,,,\n");
+          continue;
+        }
+        const TelemetryOutput& o = t.out[i];
+        std::fprintf(fp_, "%s,%s,%d-%d,%d,%llu,%.1f,%.0f,", o.name, o.mode, o.firstPad + 1, o.firstPad + o.pads,
+          o.connected ? 1 : 0, (unsigned long long)o.reconnects, o.writesPerSec, o.bytesPerSec);
+        if (o.queueKnown) std::fprintf(fp_, "%u,%u,", o.rxQueue, o.txQueue);
+        else std::fprintf(fp_, ",,");
+        std::fprintf(fp_, "%llu,%llu,%llu\n",
+          (unsigned long long)o.failures, (unsigned long long)o.coalesced, (unsigned long long)o.dropped);
+      }
+    } else {
+      std::fprintf(fp_, "{\"t\":%.3f,\"poll_hz\":%.1f,\"jitter_us\":{\"mean\":%.1f,\"max\":%.1f},"
+        "\"ui_fps\":%.1f,\"frame_ms\":{\"mean\":%.2f,\"max\":%.2f},\"ft_errors\":%llu,",
+        t.tSec, t.pollHz, t.jitterMeanUs, t.jitterMaxUs, t.uiFps, t.frameMeanMs, t.frameMaxMs,
+        (unsigned long long)t.ftErrors);
+      if (t.vsyncHz > 0.0) std::fprintf(fp_, "\"vsync\":{\"hz\":%.3f,\"err_us\":%.0f},", t.vsyncHz, t.vsyncErrUs);
+      else if (t.vsync) std::fprintf(fp_, "\"vsync\":{\"hz\":null,\"err_us\":null},");
+      std::fprintf(fp_, "\"outputs\":[");
+      for (int i = 0; i < t.outputCount; ++i) {
+        const TelemetryOutput& o = t.out[i];
+        std::fprintf(fp_, "%s{\"name\":\"%s\",\"mode\":\"%s\",\"pads\":\"%d-%d\",\"connected\":%s,\"reconnects\":%llu,"
+          "\"writes_hz\":%.1f,\"bytes_s\":%.0f,",
+          i ? "," : "", o.name, o.mode, o.firstPad + 1, o.firstPad + o.pads, o.connected ? "true" : "false",
+          (unsigned long long)o.reconnects, o.writesPerSec, o.bytesPerSec);
+        if (o.queueKnown) std::fprintf(fp_, "\"rx_queue\":%u,\"tx_queue\":%u,", o.rxQueue, o.txQueue);
+        else std::fprintf(fp_, "\"rx_queue\":null,\"tx_queue\":null,");
+        std::fprintf(fp_, "\"failures\":%llu,\"coalesced\":%llu,\"dropped\":%llu}",
+          (unsigned long long)o.failures, (unsigned long long)o.coalesced, (unsigned long long)o.dropped);
+      }
+      std::fprintf(fp_, "]}\n");
+    }
+    std::fflush(fp_);
+  }
+
+  std::thread th_;
+  std::mutex m_;
+  std::condition_variable cv_;
+  bool stop_ = false;
+  std::FILE* fp_ = nullptr;
+  StatsFormat format_ = StatsFormat::Json;
+  int intervalMs_ = 1000;
+};
 
-  // Buttons area
-  float bx = x + w * 0.70f;
-  float by = y + h * 0.55f;
-  float br = (std::min)(w, h) * 0.06f;
+static TelemetrySampler gSampler;
 
-  auto drawBtn = [&](float cx, float cy, bool on, const char* label, const char* bindStr) {
-    if (on) glColor3f(0.9f, 0.3f, 0.2f);
-    else glColor3f(0.75f, 0.75f, 0.75f);
-    drawCircle(cx, cy, br, true);
+// F4 panel, bottom left. Called by drawUIOverlay.
+static void drawStatsPanel(const TelemetrySample& t) {
+  char line[256];
+  float y = 8.0f + 16.0f * (float)t.outputCount;
+  std::snprintf(line, sizeof(line),
+    "poll %.0f Hz  jitter mean %.1f / max %.1f us  | ui %.1f fps, frame %.2f / max %.2f ms  | ft errors %llu",
+    t.pollHz, t.jitterMeanUs, t.jitterMaxUs, t.uiFps, t.frameMeanMs, t.frameMaxMs, (unsigned long long)t.ftErrors);
+  if (t.vsync) {
+    const size_t n = std::strlen(line);
+    if (t.vsyncHz > 0.0) {
+      std::snprintf(line + n, sizeof(line) - n, "  | vsync %.3f Hz, err %.0f us", t.vsyncHz, t.vsyncErrUs);
+    } else {
+      std::snprintf(line + n, sizeof(line) - n, "  | vsync not locked");
+    }
+  }
+  drawText(20.0f, y, line, 160, 230, 160, 255);
+  for (int i = 0; i < t.outputCount; ++i) {
+    const TelemetryOutput& o = t.out[i];
+    char queue[48] = "queue n/a";
+    if (o.queueKnown) std::snprintf(queue, sizeof(queue), "rx %u tx %u B", o.rxQueue, o.txQueue);
+    std::snprintf(line, sizeof(line),
+      "%s (%s, VPad%d..%d)%s  %.0f writes/s  %.0f B/s  %s  failures %llu  coalesced %llu  dropped %llu  reconnects %llu",
+      o.name, o.mode, o.firstPad + 1, o.firstPad + o.pads, o.connected ? "" : " OFFLINE",
+      o.writesPerSec, o.bytesPerSec, queue,
+      (unsigned long long)o.failures, (unsigned long long)o.coalesced, (unsigned long long)o.dropped,
+      (unsigned long long)o.reconnects);
+    const bool bad = o.failures || !o.connected;
+    y -= 16.0f;
+    drawText(20.0f, y, line, bad ? 255 : 200, bad ? 140 : 200, bad ? 140 : 200, 255);
+  }
+}
 
-    glColor3f(0.2f, 0.2f, 0.25f);
-    drawCircle(cx, cy, br, false);
+// -----------------------------------------------------------------------------
+// Render thread
+// - Owns the GL context; never touches input or the FT245.
+// - The I/O loop publishes UiSnapshots through a triple buffer (gUiState): it
+//   never waits for the render thread, and the render thread always draws one
+//   complete snapshot, however long glfwSwapBuffers takes.
+// - Redraws only when something visible changed: publishUi() publishes only
+//   if pad state, bindings or edit/learning state differ from the last publish;
+//   resizes and window refreshes set gUiRedraw. Otherwise the render thread
+//   sleeps on gUiCv and neither draws nor swaps. Frames are capped at --ui-fps.
+// - Wake-up uses the OutputWriter scheme: the I/O side only touches gUiWakeM if
+//   the render thread announced it is going to sleep.
+// - GLFW only allows glfwWaitEvents* on the main thread, which is the I/O loop,
+//   so the render side waits on its own condition variable instead.
+// -----------------------------------------------------------------------------
+struct UiSnapshot {
+  int padCount = 0;
+  uint8_t bits6[kMaxPads] = {};         // active-low, as output
+  VirtualPad pad[kMaxPads];
+  int editPad = 0;
+  VKey editKey = VKey::Up;
+  bool learning = false;
+};
 
-    char t[256];
-    std::snprintf(t, sizeof(t), "%s: %s", label, bindStr);
-    drawText(cx + br * 1.5f, cy - 6, t, 20, 20, 20, 255);
-  };
+static TripleBuffer<UiSnapshot> gUiState;
+static std::atomic<bool> gUiRedraw{false};   // redraw without a new snapshot (resize, expose)
+static std::atomic<bool> gUiSleeping{false};
+static std::mutex gUiWakeM;
+static std::condition_variable gUiCv;
+static int gUiMaxFps = 60;              // --ui-fps, set before the render thread starts
+static std::atomic<bool> gQuit{false};
+static std::atomic<int> gWinFBW{0};
+static std::atomic<int> gWinFBH{0};
+static std::string gOutputSummary;      // set before the render thread starts
+
+static void wakeUi() {
+  if (!gUiSleeping.load()) return;
+  { std::lock_guard<std::mutex> lock(gUiWakeM); }
+  gUiCv.notify_one();
+}
 
-  drawBtn(bx, by + br * 2.0f, st.b1, "B1", pad.bind[(int)VKey::B1].toString().c_str());
-  drawBtn(bx, by - br * 2.0f, st.b2, "B2", pad.bind[(int)VKey::B2].toString().c_str());
+static void requestUiRedraw() {
+  gUiRedraw.store(true);
+  wakeUi();
+}
 
-  // Edit focus highlight
-  if (selected) {
-    glColor3f(0.1f, 0.4f, 1.0f);
-    glLineWidth(3.0f);
-    drawRect(x + 2, y + 2, x + w - 2, y + h - 2, false);
-    glLineWidth(1.0f);
+// I/O thread. Cheap when nothing changed: no lock, no copy.
+static void publishUi(const uint8_t* bits6) {
+  static bool published = false;
+  static uint8_t lastBits[kMaxPads];
+  static uint32_t lastGen = 0;
+  const uint32_t gen = gPlans.current().generation;
+  static int lastPadCount = 0, lastEditPad = 0;
+  static VKey lastEditKey = VKey::Up;
+  static bool lastLearning = false;
+
+  if (published && lastGen == gen && lastPadCount == gPadCount &&
+      lastEditPad == gEditPad && lastEditKey == gEditKey && lastLearning == gLearning &&
+      std::memcmp(lastBits, bits6, (size_t)gPadCount) == 0) {
+    return;
+  }
+  published = true;
+  std::memcpy(lastBits, bits6, (size_t)gPadCount);
+  lastGen = gen;
+  lastPadCount = gPadCount;
+  lastEditPad = gEditPad;
+  lastEditKey = gEditKey;
+  lastLearning = gLearning;
+
+  UiSnapshot& ui = gUiState.writeBuffer();
+  ui.padCount = gPadCount;
+  for (int p = 0; p < gPadCount; ++p) {
+    ui.bits6[p] = bits6[p];
+    ui.pad[p] = gPad[p];
   }
+  ui.editPad = gEditPad;
+  ui.editKey = gEditKey;
+  ui.learning = gLearning;
+  gUiState.publish();
+  wakeUi();
 }
 
-static void drawUIOverlay(int w, int h) {
+static void drawUIOverlay(int w, int h, const UiSnapshot& ui) {
+  (void)w;
   char line[512];
 
-  drawText((float)20, (float)(h - 40), "GLFW 2x Virtual Pad (6-bit) - Fixed Pipeline", 240, 240, 240, 255);
+  std::snprintf(line, sizeof(line), "GLFW %dx Virtual Pad (6-bit) - Fixed Pipeline  | %s",
+    ui.padCount, gOutputSummary.c_str());
+  drawText((float)20, (float)(h - 40), line, 240, 240, 240, 255);
 
   std::snprintf(line, sizeof(line),
-    "Edit: pad=%d  target=%s  learning=%s  | F1/F2 pad, 1..6 target, SPACE learn, BACKSPACE clear, F5 save, F9 load",
-    gEditPad + 1,
-    vkeyName(gEditKey),
-    gLearning ? "ON" : "OFF");
+    "Edit: pad=%d  target=%s  learning=%s  | F1/F2/TAB pad, 1..6 target, SPACE learn, BACKSPACE clear, F5 save, F9 load, F3 dump, F4 stats, F6 tune, F8 trace",
+    ui.editPad + 1,
+    vkeyName(ui.editKey),
+    ui.learning ? "ON" : "OFF");
   drawText((float)20, (float)(h - 60), line, 220, 220, 220, 255);
 
-  if (gLearning) {
+  if (ui.learning) {
     drawText((float)20, (float)(h - 80), "Learning armed: press a key, or press a pad button, or move an axis.", 255, 220, 120, 255);
   }
+
+  if (gStatsPanel.load(std::memory_order_relaxed)) drawStatsPanel(gTelemetry.read());
+}
+
+static void renderThreadMain(GLFWwindow* w) {
+  traceSetThreadName("render");
+  glfwMakeContextCurrent(w);
+  glfwSwapInterval(1);
+  loadGlBufferObjects();
+
+  using Clock = std::chrono::steady_clock;
+  const Clock::duration minFrame = std::chrono::duration_cast<Clock::duration>(
+    std::chrono::duration<double>(1.0 / (double)gUiMaxFps));
+  Clock::time_point nextFrame = Clock::now();
+  uint64_t frames = 0;
+
+  while (!gQuit.load(std::memory_order_relaxed)) {
+    const bool fresh = gUiState.update();
+    const bool redraw = gUiRedraw.exchange(false);
+    gTelemetry.update();
+    if (!fresh && !redraw) {
+      std::unique_lock<std::mutex> lock(gUiWakeM);
+      gUiSleeping.store(true);
+      // Timeout only so a quit from the signal handler (which cannot notify) is seen.
+      if (!gUiState.pending() && !gUiRedraw.load() && !gQuit.load(std::memory_order_relaxed)) {
+        gUiCv.wait_for(lock, std::chrono::milliseconds(250));
+      }
+      gUiSleeping.store(false);
+      continue;
+    }
+    const UiSnapshot& ui = gUiState.read();
+    const uint64_t tFrame = nowNs();
+
+    int fbw = gWinFBW.load(std::memory_order_relaxed);
+    int fbh = gWinFBH.load(std::memory_order_relaxed);
+
+    glDisable(GL_DEPTH_TEST);
+    glClearColor(0.08f, 0.09f, 0.11f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    setOrtho(fbw, fbh);
+
+    // Up to 2 pads side by side, more in two rows.
+    const int n = ui.padCount;
+    const int cols = n <= 2 ? (std::max)(n, 1) : (n + 1) / 2;
+    const int rows = n <= 2 ? 1 : 2;
+
+    float cellW = fbw * 0.92f / (float)cols;
+    float cellH = fbh * 0.70f / (float)rows;
+    float padH = rows > 1 ? cellH * 0.96f : cellH;
+
+    for (int p = 0; p < n; ++p) {
+      float px = fbw * 0.04f + (float)(p % cols) * cellW;
+      float py = fbh * 0.12f + (float)(rows - 1 - p / cols) * cellH;
+      drawPadDiagram(px, py, cellW, padH, ui.bits6[p], ui.pad[p], p, (ui.editPad == p));
+    }
+
+    drawUIOverlay(fbw, fbh, ui);
+    gTextCache.endFrame();
+
+    const uint64_t tSwap = nowNs();
+    glfwSwapBuffers(w);
+    ++frames;
+    const uint64_t tSwapped = nowNs();
+    traceEvent("glfwSwapBuffers", tSwap, tSwapped);
+    traceEvent("frame", tFrame, tSwapped);
+    const uint64_t frameNs = tSwapped - tFrame;
+    gIoCounters.frames.fetch_add(1, std::memory_order_relaxed);
+    gIoCounters.frameSumNs.fetch_add(frameNs, std::memory_order_relaxed);
+    atomicMax(gIoCounters.frameMaxNs, frameNs);
+
+    // Cap the UI rate; changes arriving meanwhile are coalesced into the next frame.
+    nextFrame += minFrame;
+    const Clock::time_point now = Clock::now();
+    if (nextFrame < now) nextFrame = now;
+    std::this_thread::sleep_until(nextFrame);
+  }
+  std::fprintf(stderr, "[ui] %llu frames rendered\n", (unsigned long long)frames);
+
+  gTextCache.clear();
+  for (PadGeometry& g : gPadGeom) g.release();
+  glfwMakeContextCurrent(nullptr);
 }
 
 // -----------------------------------------------------------------------------
@@ -859,28 +5738,62 @@ static void drawUIOverlay(int w, int h) {
 // -----------------------------------------------------------------------------
 static void onJoystick(int jid, int event) {
   if (event == GLFW_CONNECTED) {
-    std::fprintf(stderr, "[joy] CONNECT jid=%d name=%s gamepad=%d\n",
-      jid, jidName(jid), glfwJoystickIsGamepad(jid) ? 1 : 0);
+    internJoystickName(jid);
+    gJoy[jid].isGamepad = glfwJoystickIsGamepad(jid);
+    joystickAttached(jid);
+    std::fprintf(stderr, "[joy] CONNECT jid=%d name=%s guid=%s gamepad=%d\n",
+      jid, gJoy[jid].name, gJoy[jid].guid, gJoy[jid].isGamepad ? 1 : 0);
   } else if (event == GLFW_DISCONNECTED) {
+    joystickDetached(jid);
     std::fprintf(stderr, "[joy] DISCONNECT jid=%d\n", jid);
   }
 }
 
+// Joysticks plugged in before glfwSetJoystickCallback get no connect event.
+static void attachPresentJoysticks() {
+  for (int jid = GLFW_JOYSTICK_1; jid <= GLFW_JOYSTICK_LAST; ++jid) {
+    if (glfwJoystickPresent(jid)) onJoystick(jid, GLFW_CONNECTED);
+  }
+}
+
+static void onFramebufferSize(GLFWwindow* w, int fbw, int fbh) {
+  (void)w;
+  gWinFBW.store(fbw, std::memory_order_relaxed);
+  gWinFBH.store(fbh, std::memory_order_relaxed);
+  requestUiRedraw();
+}
+
+static void onWindowRefresh(GLFWwindow* w) {
+  (void)w;
+  requestUiRedraw();
+}
+
 static void handleHotkeysOnce() {
-  // Save / Load
-  if (keyPressedEdge(GLFW_KEY_F5)) {
-    bool ok = saveMappings();
-    std::fprintf(stderr, ok ? "[map] saved to %s\n" : "[map] save failed\n", kMapFile);
+  // Save / Load (written and parsed on the map file thread)
+  if (keyPressedEdge(GLFW_KEY_F5)) gMapFiles.save(formatPadMap());
+  if (keyPressedEdge(GLFW_KEY_F9)) gMapFiles.reload();
+
+  // Latency stats
+  if (keyPressedEdge(GLFW_KEY_F3)) {
+    dumpLatencyStats(stderr);
+    dumpDeviceLatencyStats(stderr);
   }
-  if (keyPressedEdge(GLFW_KEY_F9)) {
-    bool ok = loadMappings();
-    std::fprintf(stderr, ok ? "[map] loaded from %s\n" : "[map] load failed\n", kMapFile);
+  if (keyPressedEdge(GLFW_KEY_F4)) {
+    gStatsPanel.store(!gStatsPanel.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    requestUiRedraw();
+  }
+  if (keyPressedEdge(GLFW_KEY_F8)) {
+    if (gTraceDumper.enabled()) gTraceDumper.request("F8", 0);
+    else std::fprintf(stderr, "[trace] not recording; start with --trace FILE\n");
+  }
+  if (keyPressedEdge(GLFW_KEY_F6)) {
+    for (const auto& wr : gWriters) wr->requestRetune();
   }
 
   // Select pad
   if (keyPressedEdge(GLFW_KEY_F1)) gEditPad = 0;
-  if (keyPressedEdge(GLFW_KEY_F2)) gEditPad = 1;
-  if (keyPressedEdge(GLFW_KEY_TAB)) gEditPad = 1 - gEditPad;
+  if (keyPressedEdge(GLFW_KEY_F2) && gPadCount > 1) gEditPad = 1;
+  if (keyPressedEdge(GLFW_KEY_TAB)) gEditPad = (gEditPad + 1) % gPadCount;
 
   // Select target control 1..6
   if (keyPressedEdge(GLFW_KEY_1)) gEditKey = VKey::Up;
@@ -902,103 +5815,872 @@ static void handleHotkeysOnce() {
   }
 }
 
-int main() {
-  std::memset(gKeyDown, 0, sizeof(gKeyDown));
-  std::memset(gKeyDownPrev, 0, sizeof(gKeyDownPrev));
+struct Options {
+  int rateHz = 1000;       // I/O loop rate (sampling + FT245 output)
+  bool headless = false;   // no window / GL context; sample -> FT245 only
+  int latencyTest = 0;     // > 0: run N hardware loopback round trips and exit
+  int probeIndex = -1;     // loopback probe device (-1 = sync bit-bang read-back)
+  OutputKind outputKind = OutputKind::Ft245;  // --output: default backend
+  Ft245Layout output = Ft245Layout::Single;   // default FT245 pin layout
+  std::vector<std::string> deviceSpecs;      // --device SERIAL[:MODE] (empty = first free device)
+  int pads = 0;            // --pads (0 = max(2, pads carried by devices))
+  bool listDevices = false;
+  std::vector<TurboSpec> turbo;     // --turbo
+  std::vector<MacroSpec> macros;    // --macro
+  uint32_t bitBangRate = 8000;      // --bitbang-rate, streamed samples/s
+  uint32_t macroFrameUs = 16683;    // --macro-frame-us
+  std::string recordPath;           // --record FILE
+  std::string replayPath;           // --replay FILE (no window, bindings ignored)
+  bool replayLoop = false;          // --replay-loop: restart at the end (soak tests)
+  int uiFps = 60;                   // --ui-fps: max UI frame rate (UI redraws on change only)
+  std::string udpSend;              // --udp-send HOST:PORT
+  std::string udpListen;            // --udp-listen [HOST:]PORT (no window, bindings ignored)
+  uint32_t uartBaud = 1000000;      // --uart-baud
+  bool realtime = false;            // --rt: real-time priority for I/O + writer threads
+  int cpu = -1;                     // --cpu N: pin the I/O thread (-1 = any)
+  uint32_t spinUs = 50;             // --spin-us: busy-wait before each tick deadline
+  std::string statsFile;            // --stats-file FILE ("-" = stdout)
+  StatsFormat statsFormat = StatsFormat::Json;   // --stats-format json|csv
+  int statsIntervalMs = 1000;       // --stats-interval MS
+  int vsyncPin = 0;                 // --vsync D6|D7 (0 = free-running)
+  bool vsyncRising = false;         // --vsync-edge rise|fall
+  int vsyncOffsetUs = 0;            // --vsync-offset-us: target reads the port this long after the edge
+  int vsyncLeadUs = 1500;           // --vsync-lead-us: sample + write this long before that
+  int minPulseUs = -1;              // --min-pulse-us (-1 = one target frame, 0 = off)
+  InputSource input = InputSource::Glfw;   // --input glfw|native
+  std::string tracePath;            // --trace FILE (empty = no timeline zones)
+  uint32_t traceThresholdUs = 0;    // --trace-threshold-us (0 = F8 only)
+  FtdiTuneMode ftdiTune = FtdiTuneMode::Auto;   // --ftdi-tune auto|force|off
+};
 
-  glfwSetErrorCallback(onError);
-  if (!glfwInit()) {
-    std::fprintf(stderr, "glfwInit failed\n");
-    return 1;
+static bool parseOutputMode(const char* m, OutputKind& kind, Ft245Layout& layout) {
+  kind = OutputKind::Ft245;
+  if (std::strcmp(m, "single") == 0) layout = Ft245Layout::Single;
+  else if (std::strcmp(m, "mux") == 0) layout = Ft245Layout::Mux2;
+  else if (std::strcmp(m, "uart") == 0) kind = OutputKind::Uart;
+  else if (std::strcmp(m, "null") == 0) kind = OutputKind::Null;
+  else return false;
+  return true;
+}
+
+static void printUsage(const char* argv0) {
+  std::fprintf(stderr,
+    "usage: %s [--rate HZ] [--headless] [--output single|mux|uart|null] [--device SERIAL[:MODE]]...\n"
+    "          [--pads N] [--list-devices] [--latency-test N [--probe INDEX]]\n"
+    "          [--turbo PAD:BTN:HZ]... [--macro KEY:PAD:STEPS]... [--bitbang-rate N] [--macro-frame-us US]\n"
+    "          [--min-pulse-us US] [--input glfw|native]\n"
+    "          [--record FILE] [--replay FILE [--replay-loop]] [--ui-fps N]\n"
+    "          [--udp-send HOST:PORT] [--udp-listen [HOST:]PORT] [--uart-baud N]\n"
+    "          [--rt] [--cpu N] [--spin-us US] [--stats-file FILE [--stats-format json|csv] [--stats-interval MS]]\n"
+    "          [--vsync D6|D7 [--vsync-edge rise|fall] [--vsync-offset-us US] [--vsync-lead-us US]]\n"
+    "          [--trace FILE [--trace-threshold-us US]] [--ftdi-tune auto|force|off]\n"
+    "  --rate HZ          input sampling / FT245 output rate (default 1000)\n"
+    "  --output MODE      default output mode per device\n"
+    "                     single: bit-bang, one pad on D0..D5 (default)\n"
+    "                     mux:    bit-bang, two pads, D6 = pad select, D7 = strobe\n"
+    "                     uart:   UART/FIFO mode, two pads in a 1-2 byte frame\n"
+    "                     null:   no device; two pads, nothing written (host-side timing)\n"
+    "  --uart-baud N      baud rate of uart devices (default 1000000)\n"
+    "  --device S[:MODE]  open FT245 by serial number (repeatable); devices take\n"
+    "                     consecutive pads in order (default: first free device)\n"
+    "  --pads N           number of virtual pads, 1..%d\n"
+    "  --list-devices     print FTDI devices and exit\n"
+    "  --headless         no window or GL context; load %s, drive FT245 only\n"
+    "  --latency-test N   measure N host->pin->host round trips on device 0 and exit\n"
+    "  --probe INDEX      read pins back via a second FTDI device instead of sync bit-bang\n"
+    "  --turbo P:B:HZ     auto-fire button B (U D L R 1 2) of pad P at HZ while held\n"
+    "  --macro K:P:STEPS  GLFW key code K plays STEPS on pad P, e.g. 68:1:D*1,DR*1,R*1,1*2\n"
+    "                     (BUTTONS*FRAMES per step, '-' = neutral)\n"
+    "  --bitbang-rate N   samples/s streamed to devices using turbo/macros (default 8000)\n"
+    "  --macro-frame-us U length of one macro frame (default 16683 = 59.94 Hz)\n"
+    "  --input SRC        glfw (default) or native: also read pads on a HID reader thread\n"
+    "                     (evdev / XInput / IOHIDManager) at their own report rate\n"
+    "  --min-pulse-us US  hold every press on the output at least US (default: one target\n"
+    "                     frame, the --vsync period or --macro-frame-us; 0 = off)\n"
+    "  --record FILE      log every pad state change (binary, delta encoded)\n"
+    "  --replay FILE      drive the FT245 devices from a recorded log and exit\n"
+    "  --replay-loop      restart the replay at the end of the log until stopped\n"
+    "  --ui-fps N         max UI frame rate; the UI only redraws on change (default 60)\n"
+    "  --udp-send H:P     also stream the pad states to a remote --udp-listen\n"
+    "  --udp-listen [H:]P drive the FT245 devices from a remote --udp-send (no window)\n"
+    "  --rt               real-time priority for the I/O and writer threads\n"
+    "  --cpu N            pin the I/O thread to CPU N\n"
+    "  --spin-us US       busy-wait the last US before each tick (default 50, 0 = off)\n"
+    "  --stats-file FILE  append telemetry every --stats-interval ms ('-' = stdout)\n"
+    "  --stats-format F   json (one object per line, default) or csv (one row per output)\n"
+    "  --stats-interval MS telemetry period for the file and the F4 panel (default 1000)\n"
+    "  --vsync D6|D7      target VSYNC / port strobe on this input pin of the first single-mode\n"
+    "                     FT245; one tick per target frame is moved just before its port read\n"
+    "  --vsync-edge E     rise or fall (default) marks the start of a frame\n"
+    "  --vsync-offset-us US when the target reads the port, after the edge (default 0)\n"
+    "  --vsync-lead-us US sample and write this long before that read (default 1500)\n"
+    "  --trace FILE       record timeline zones per thread; F8 writes the last seconds\n"
+    "                     as Chrome trace JSON to FILE-1.json, FILE-2.json, ...\n"
+    "  --trace-threshold-us US also write one when a tick or wake-up takes longer than US\n"
+    "  --ftdi-tune M      auto (default): measure the USB transfer settings of an FT245 the\n"
+    "                     first time it is seen and keep them in %s; force: measure\n"
+    "                     again this run; off: fixed defaults\n",
+    argv0, kMaxPads, kMapFile, kTuneFile);
+}
+
+static bool parseArgs(int argc, char** argv, Options& opt) {
+  for (int i = 1; i < argc; ++i) {
+    const char* a = argv[i];
+    if (std::strcmp(a, "--rate") == 0 && i + 1 < argc) {
+      opt.rateHz = std::atoi(argv[++i]);
+      if (opt.rateHz < 1 || opt.rateHz > 20000) {
+        std::fprintf(stderr, "--rate must be in 1..20000\n");
+        return false;
+      }
+    } else if (std::strcmp(a, "--headless") == 0) {
+      opt.headless = true;
+    } else if (std::strcmp(a, "--output") == 0 && i + 1 < argc) {
+      if (!parseOutputMode(argv[++i], opt.outputKind, opt.output)) {
+        std::fprintf(stderr, "--output must be single, mux, uart or null\n");
+        return false;
+      }
+    } else if (std::strcmp(a, "--uart-baud") == 0 && i + 1 < argc) {
+      opt.uartBaud = (uint32_t)std::atoi(argv[++i]);
+      if (opt.uartBaud < 300 || opt.uartBaud > 3000000) {
+        std::fprintf(stderr, "--uart-baud must be in 300..3000000\n");
+        return false;
+      }
+    } else if (std::strcmp(a, "--device") == 0 && i + 1 < argc) {
+      opt.deviceSpecs.push_back(argv[++i]);
+    } else if (std::strcmp(a, "--pads") == 0 && i + 1 < argc) {
+      opt.pads = std::atoi(argv[++i]);
+      if (opt.pads < 1 || opt.pads > kMaxPads) {
+        std::fprintf(stderr, "--pads must be in 1..%d\n", kMaxPads);
+        return false;
+      }
+    } else if (std::strcmp(a, "--list-devices") == 0) {
+      opt.listDevices = true;
+    } else if (std::strcmp(a, "--latency-test") == 0 && i + 1 < argc) {
+      opt.latencyTest = std::atoi(argv[++i]);
+      if (opt.latencyTest < 1) {
+        std::fprintf(stderr, "--latency-test needs a positive count\n");
+        return false;
+      }
+    } else if (std::strcmp(a, "--probe") == 0 && i + 1 < argc) {
+      opt.probeIndex = std::atoi(argv[++i]);
+    } else if (std::strcmp(a, "--turbo") == 0 && i + 1 < argc) {
+      TurboSpec t;
+      if (!parseTurboSpec(argv[++i], t) || t.pad >= kMaxPads) {
+        std::fprintf(stderr, "--turbo expects PAD:BUTTON:HZ (e.g. 1:B1:15)\n");
+        return false;
+      }
+      opt.turbo.push_back(t);
+    } else if (std::strcmp(a, "--macro") == 0 && i + 1 < argc) {
+      MacroSpec m;
+      if (!parseMacroSpec(argv[++i], m) || m.pad >= kMaxPads || opt.macros.size() >= 255) {
+        std::fprintf(stderr, "--macro expects KEY:PAD:BUTTONS*FRAMES,... (e.g. 68:1:D*1,DR*1,R*1,1*2)\n");
+        return false;
+      }
+      opt.macros.push_back(m);
+    } else if (std::strcmp(a, "--bitbang-rate") == 0 && i + 1 < argc) {
+      opt.bitBangRate = (uint32_t)std::atoi(argv[++i]);
+      if (opt.bitBangRate < 1000 || opt.bitBangRate > 100000) {
+        std::fprintf(stderr, "--bitbang-rate must be in 1000..100000\n");
+        return false;
+      }
+    } else if (std::strcmp(a, "--record") == 0 && i + 1 < argc) {
+      opt.recordPath = argv[++i];
+    } else if (std::strcmp(a, "--replay") == 0 && i + 1 < argc) {
+      opt.replayPath = argv[++i];
+    } else if (std::strcmp(a, "--replay-loop") == 0) {
+      opt.replayLoop = true;
+    } else if (std::strcmp(a, "--udp-send") == 0 && i + 1 < argc) {
+      opt.udpSend = argv[++i];
+    } else if (std::strcmp(a, "--udp-listen") == 0 && i + 1 < argc) {
+      opt.udpListen = argv[++i];
+    } else if (std::strcmp(a, "--stats-file") == 0 && i + 1 < argc) {
+      opt.statsFile = argv[++i];
+    } else if (std::strcmp(a, "--stats-format") == 0 && i + 1 < argc) {
+      const char* f = argv[++i];
+      if (std::strcmp(f, "json") == 0) opt.statsFormat = StatsFormat::Json;
+      else if (std::strcmp(f, "csv") == 0) opt.statsFormat = StatsFormat::Csv;
+      else {
+        std::fprintf(stderr, "--stats-format must be json or csv\n");
+        return false;
+      }
+    } else if (std::strcmp(a, "--stats-interval") == 0 && i + 1 < argc) {
+      opt.statsIntervalMs = std::atoi(argv[++i]);
+      if (opt.statsIntervalMs < 50 || opt.statsIntervalMs > 3600000) {
+        std::fprintf(stderr, "--stats-interval must be in 50..3600000\n");
+        return false;
+      }
+    } else if (std::strcmp(a, "--input") == 0 && i + 1 < argc) {
+      const char* v = argv[++i];
+      if (std::strcmp(v, "glfw") == 0) opt.input = InputSource::Glfw;
+      else if (std::strcmp(v, "native") == 0) opt.input = InputSource::Native;
+      else {
+        std::fprintf(stderr, "--input must be glfw or native\n");
+        return false;
+      }
+    } else if (std::strcmp(a, "--trace") == 0 && i + 1 < argc) {
+      opt.tracePath = argv[++i];
+    } else if (std::strcmp(a, "--trace-threshold-us") == 0 && i + 1 < argc) {
+      const int v = std::atoi(argv[++i]);
+      if (v < 1 || v > 10000000) {
+        std::fprintf(stderr, "--trace-threshold-us must be in 1..10000000\n");
+        return false;
+      }
+      opt.traceThresholdUs = (uint32_t)v;
+    } else if (std::strcmp(a, "--ftdi-tune") == 0 && i + 1 < argc) {
+      const char* m = argv[++i];
+      if (std::strcmp(m, "auto") == 0) opt.ftdiTune = FtdiTuneMode::Auto;
+      else if (std::strcmp(m, "force") == 0) opt.ftdiTune = FtdiTuneMode::Force;
+      else if (std::strcmp(m, "off") == 0) opt.ftdiTune = FtdiTuneMode::Off;
+      else {
+        std::fprintf(stderr, "--ftdi-tune must be auto, force or off\n");
+        return false;
+      }
+    } else if (std::strcmp(a, "--min-pulse-us") == 0 && i + 1 < argc) {
+      opt.minPulseUs = std::atoi(argv[++i]);
+      if (opt.minPulseUs < 0 || opt.minPulseUs > 1000000) {
+        std::fprintf(stderr, "--min-pulse-us must be in 0..1000000\n");
+        return false;
+      }
+    } else if (std::strcmp(a, "--vsync") == 0 && i + 1 < argc) {
+      const char* v = argv[++i];
+      if (std::strcmp(v, "D6") == 0 || std::strcmp(v, "6") == 0) opt.vsyncPin = 6;
+      else if (std::strcmp(v, "D7") == 0 || std::strcmp(v, "7") == 0) opt.vsyncPin = 7;
+      else {
+        std::fprintf(stderr, "--vsync must be D6 or D7\n");
+        return false;
+      }
+    } else if (std::strcmp(a, "--vsync-edge") == 0 && i + 1 < argc) {
+      const char* e = argv[++i];
+      if (std::strcmp(e, "rise") == 0) opt.vsyncRising = true;
+      else if (std::strcmp(e, "fall") == 0) opt.vsyncRising = false;
+      else {
+        std::fprintf(stderr, "--vsync-edge must be rise or fall\n");
+        return false;
+      }
+    } else if (std::strcmp(a, "--vsync-offset-us") == 0 && i + 1 < argc) {
+      opt.vsyncOffsetUs = std::atoi(argv[++i]);
+      if (opt.vsyncOffsetUs < 0 || opt.vsyncOffsetUs > 30000) {
+        std::fprintf(stderr, "--vsync-offset-us must be in 0..30000\n");
+        return false;
+      }
+    } else if (std::strcmp(a, "--vsync-lead-us") == 0 && i + 1 < argc) {
+      opt.vsyncLeadUs = std::atoi(argv[++i]);
+      if (opt.vsyncLeadUs < 0 || opt.vsyncLeadUs > 10000) {
+        std::fprintf(stderr, "--vsync-lead-us must be in 0..10000\n");
+        return false;
+      }
+    } else if (std::strcmp(a, "--rt") == 0) {
+      opt.realtime = true;
+    } else if (std::strcmp(a, "--cpu") == 0 && i + 1 < argc) {
+      opt.cpu = std::atoi(argv[++i]);
+      if (opt.cpu < 0 || opt.cpu > 63) {
+        std::fprintf(stderr, "--cpu must be in 0..63\n");
+        return false;
+      }
+    } else if (std::strcmp(a, "--spin-us") == 0 && i + 1 < argc) {
+      opt.spinUs = (uint32_t)std::atoi(argv[++i]);
+      if (opt.spinUs > 2000) {
+        std::fprintf(stderr, "--spin-us must be in 0..2000\n");
+        return false;
+      }
+    } else if (std::strcmp(a, "--ui-fps") == 0 && i + 1 < argc) {
+      opt.uiFps = std::atoi(argv[++i]);
+      if (opt.uiFps < 1 || opt.uiFps > 1000) {
+        std::fprintf(stderr, "--ui-fps must be in 1..1000\n");
+        return false;
+      }
+    } else if (std::strcmp(a, "--macro-frame-us") == 0 && i + 1 < argc) {
+      opt.macroFrameUs = (uint32_t)std::atoi(argv[++i]);
+      if (opt.macroFrameUs < 1000) {
+        std::fprintf(stderr, "--macro-frame-us must be at least 1000\n");
+        return false;
+      }
+    } else {
+      printUsage(argv[0]);
+      return false;
+    }
   }
+  return true;
+}
 
-  // Portable fixed pipeline context
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 2);
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+// Turns --device specs (or, without any, whichever FTDI device turns up first;
+// with --output null, a null target) into writer targets with consecutive VPad
+// ranges. Returns the number of pads the targets carry, or -1 on a bad spec.
+static int resolveOutputTargets(const Options& opt, std::vector<OutputTarget>& out) {
+  out.clear();
+  for (const std::string& specIn : opt.deviceSpecs) {
+    OutputTarget t;
+    t.kind = opt.outputKind == OutputKind::Null ? OutputKind::Ft245 : opt.outputKind;
+    t.layout = opt.output;
+    std::string spec = specIn;
+    size_t colon = spec.rfind(':');
+    if (colon != std::string::npos) {
+      if (!parseOutputMode(spec.c_str() + colon + 1, t.kind, t.layout) || t.kind == OutputKind::Null) {
+        std::fprintf(stderr, "--device %s: mode must be single, mux or uart\n", specIn.c_str());
+        return -1;
+      }
+      spec.resize(colon);
+    }
+    t.serial = spec;
+    out.push_back(t);
+  }
 
-  GLFWwindow* w = glfwCreateWindow(1200, 700, "padviz", nullptr, nullptr);
-  if (!w) {
-    std::fprintf(stderr, "glfwCreateWindow failed\n");
-    glfwTerminate();
-    return 1;
+  if (out.empty() && opt.outputKind == OutputKind::Null) {
+    OutputTarget t;
+    t.kind = OutputKind::Null;
+    t.serial = "null";
+    out.push_back(t);
+  } else if (out.empty()) {
+    OutputTarget t;   // resolved by the writer at each (re)connect
+    t.kind = opt.outputKind;
+    t.serial = kAnyDevice;
+    t.layout = opt.output;
+    out.push_back(t);
   }
 
-  glfwMakeContextCurrent(w);
-  glfwSwapInterval(1);
+  int pad = 0;
+  for (OutputTarget& t : out) {
+    t.firstPad = pad;
+    pad += outputTargetPads(t);
+  }
+  if (pad > kMaxPads) {
+    std::fprintf(stderr, "[ft245] devices carry %d pads, max is %d\n", pad, kMaxPads);
+    return -1;
+  }
+  return pad;
+}
 
-  glfwSetKeyCallback(w, onKey);
-  glfwSetJoystickCallback(onJoystick);
+static void printFt245Devices() {
+  std::vector<Ft245DeviceInfo> devs = enumerateFt245Devices();
+  std::fprintf(stderr, "[ft245] %d device(s)\n", (int)devs.size());
+  for (size_t i = 0; i < devs.size(); ++i) {
+    const Ft245DeviceInfo& d = devs[i];
+    std::fprintf(stderr, "[ft245]   #%d serial=%s desc=\"%s\" loc=0x%lx%s\n",
+      (int)i, d.serial.c_str(), d.description.c_str(), d.locId, d.opened ? " (in use)" : "");
+  }
+}
 
-  setDefaultBindings();
-  loadMappings(); // if exists, override defaults
+static void onSignal(int sig) {
+  (void)sig;
+  gQuit.store(true, std::memory_order_relaxed);
+}
 
+// -----------------------------------------------------------------------------
+// Key fast path
+// - onKey -> onKeyFastPath: if the key feeds any compiled binding, re-run the
+//   plan (the joystick part reads the last snapshot, which is what was already
+//   being output) and hand a changed result to the writers immediately, instead
+//   of at the end of glfwPollEvents / the joystick snapshot.
+// - The tick that follows sees the same state and submits nothing new.
+// -----------------------------------------------------------------------------
+static uint8_t gOutBits6[kMaxPads] = {0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F};  // last handed to writers
+
+static void onKeyFastPath(int key, uint64_t tNs) {
+  const BindPlan& plan = gPlans.current();
+  if (!plan.keyPads[key]) return;
+  TRACE_ZONE("onKeyFastPath");
+  uint8_t bits6[kMaxPads];
+  std::memset(bits6, 0x3F, sizeof(bits6));
+  plan.eval(bits6);
+  gPressLatch.apply(bits6, plan.padCount, tNs);
+  if (std::memcmp(bits6, gOutBits6, sizeof(bits6)) == 0) return;
+  std::memcpy(gOutBits6, bits6, sizeof(bits6));
 
 #if 1
-  // Try to enable FT245 output (device index 0).
-  // If not present, we continue without FT245 output.
-  if (gFt245.open(0)) {
-    std::fprintf(stderr, "[ft245] enabled (index=0) idle=111111\n");
-  } else {
-    std::fprintf(stderr, "[ft245] disabled (open failed). Set -DFTDI_D2XX_ROOT=... and ensure drivers are installed.\n");
-  }
+  for (const auto& wr : gWriters) wr->submit(bits6, tNs);
 #endif
+  gRecorder.tick(tNs, bits6);
+  gLat.keyFast.record(nowNs() - tNs);
+}
 
-  while (!glfwWindowShouldClose(w)) {
-    glfwPollEvents();
+// -----------------------------------------------------------------------------
+// I/O loop (main thread)
+// - w == nullptr runs headless: no hotkeys/learning (there is no keyboard focus
+//   without a window) and nothing is published for rendering.
+// - Joystick hotplug still arrives through glfwPollEvents -> onJoystick.
+// -----------------------------------------------------------------------------
+static void runIoLoop(GLFWwindow* w, const Options& opt) {
+  const int rateHz = opt.rateHz;
+  const uint64_t periodNs = 1000000000ull / (uint64_t)rateHz;
+  std::fprintf(stderr, "[io] rate=%d Hz%s\n", rateHz, w ? "" : " (headless)");
+  traceSetThreadName("io");
+
+  uint64_t next = nowNs();
+  while (!gQuit.load(std::memory_order_relaxed) && !(w && glfwWindowShouldClose(w))) {
+    const uint64_t tPoll = nowNs();
+    gPlans.acquire();   // binding edits submitted since the last tick
+    gMapFiles.adopt();  // padmap.txt reloaded since the last tick
+    {
+      TRACE_ZONE("glfwPollEvents");
+      glfwPollEvents();
+    }
 
     // Update caches
-    updateJoystickCaches();
+    const uint64_t tNative = updateJoystickCaches();
+    if (gJoyListChanged) {
+      // A device came or went: bindings follow it to its jid.
+      gJoyListChanged = false;
+      if (resolveJoystickBindings()) rebuildBindPlan();
+    }
+    const uint64_t tPolled = nowNs();
+    gLat.poll.record(tPolled - tPoll);
+
+    // Key and native HID events carry their own timestamps; GLFW joystick
+    // changes are only seen at poll.
+    uint64_t tInput = 0;
+    gTickKeyPressCount = 0;
+    for (KeyEvent ev; gKeyEvents.pop(ev);) {
+      if (!tInput) tInput = ev.tNs;
+      if (ev.action == GLFW_PRESS && gTickKeyPressCount < kMaxTickKeyPresses) {
+        gTickKeyPresses[gTickKeyPressCount++] = ev.key;
+      }
+    }
+    if (tNative && (!tInput || tNative < tInput)) tInput = tNative;
+    if (!tInput) tInput = tPoll;
+
+    if (w) {
+      // Handle hotkeys (edge-based)
+      handleHotkeysOnce();
+
+      // Apply learning if armed
+      applyLearningIfTriggered();
 
-    // Handle hotkeys (edge-based)
-    handleHotkeysOnce();
+#if 1
+      // Macro trigger keys -> owning writer
+      for (size_t m = 0; m < gMacros.size(); ++m) {
+        if (!keyPressedEdge(gMacros[m].key)) continue;
+        for (const auto& wr : gWriters) wr->triggerMacro((uint8_t)m);
+      }
+#endif
+    }
+
+    // Sample pads (compiled plan -> active-low bits6 per pad). Pads beyond
+    // gPadCount that a device still carries stay idle.
+    uint8_t bits6[kMaxPads];
+    std::memset(bits6, 0x3F, sizeof(bits6));
+    const uint64_t tEval = nowNs();
+    gPlans.current().eval(bits6);
+    const uint64_t tEvaluated = nowNs();
+    gLat.eval.record(tEvaluated - tEval);
+
+#ifndef NDEBUG
+    // Before the latch: the reference path has no notion of held presses.
+    for (int p = 0; p < gPadCount; ++p) {
+      static bool reported = false;
+      uint8_t ref = packBits6ActiveLow(gPad[p].sample());
+      if (ref != bits6[p] && !reported) {
+        std::fprintf(stderr, "[plan] mismatch pad=%d plan=0x%02X ref=0x%02X\n", p + 1, bits6[p], ref);
+        reported = true;
+      }
+    }
+#endif
 
-    // Apply learning if armed
-    applyLearningIfTriggered();
+    // Minimum pulse width follows the target's frame once --vsync has locked.
+    if (gMinPulseUs < 0) {
+      const double hz = gVsync.lockedHz();
+      gPressLatch.setMinPulseNs(hz > 0.0 ? (uint64_t)(1e9 / hz) : (uint64_t)gMacroFrameUs * 1000u);
+    }
+    gPressLatch.apply(bits6, gPlans.current().padCount, tEvaluated);
 
-    // Sample pads
-    Digital6 s0 = gPad[0].sample();
-    Digital6 s1 = gPad[1].sample();
+    gRecorder.tick(tPoll, bits6);
 
 #if 1
-    // Drive FT245 D0..D5 with 6-bit active-low pattern (VPad1)
-    if (gFt245.isOpen()) {
-      uint8_t bits6 = packBits6ActiveLow(s0);
-      gFt245.writeBits6(bits6);
+    // Hand each output writer the 6-bit active-low patterns of its pads
+    for (const auto& wr : gWriters) wr->submit(bits6, tInput);
+    std::memcpy(gOutBits6, bits6, sizeof(gOutBits6));
+#endif
+
+    // Hand the result to the render thread
+    if (w) publishUi(bits6);
+
+    // Update key previous states last
+    updateKeyPrev();
+    const uint64_t tDone = nowNs();
+    gLat.tick.record(tDone - tPoll);
+    traceEvent("tick", tPoll, tDone);
+    gTraceDumper.check("tick", tDone - tPoll);
+
+    // Pace to --rate. If we fell behind by more than a period (e.g. the OS
+    // suspended us), resync instead of bursting to catch up.
+    next += periodNs;
+    const uint64_t now = nowNs();
+    if (next + periodNs < now) next = now;
+    // Locked to the target's VSYNC: pull the tick nearest to its next port
+    // read onto it; the ticks in between keep the --rate cadence.
+    if (gVsync.enabled()) {
+      const uint64_t v = gVsync.nextSampleAfter(now, gVsyncSampleOffsetNs);
+      if (v && v < next + periodNs / 2) {
+        next = v;
+        ++gVsyncAlignedTicks;
+      }
+    }
+    const uint64_t woke = gPacer.sleepUntil(next);
+    const uint64_t late = woke - next;
+    traceEvent("sleep", now, woke);
+    gTraceDumper.check("wake-up", late);
+    gLat.jitter.record(late);
+    gIoCounters.ticks.fetch_add(1, std::memory_order_relaxed);
+    gIoCounters.jitterSumNs.fetch_add(late, std::memory_order_relaxed);
+    atomicMax(gIoCounters.jitterMaxNs, late);
+  }
+}
+
+// Starts a writer thread per target. Never blocks: each writer opens its
+// device in the background and keeps retrying while it is missing.
+static void startOutputWriters(const Options& opt, const std::vector<OutputTarget>& targets) {
+  gTurbo = opt.turbo;
+  gMacros = opt.macros;
+  gBitBangRate = opt.bitBangRate;
+  gMacroFrameUs = opt.macroFrameUs;
+  gUartBaud = opt.uartBaud;
+  gFtdiTuneMode = opt.ftdiTune;
+  if (gFtdiTuneMode != FtdiTuneMode::Off) gFtdiProfiles.load(kTuneFile);
+  gVsyncSampleOffsetNs = ((int64_t)opt.vsyncOffsetUs - opt.vsyncLeadUs) * 1000;
+  bool vsyncSource = false;
+
+  for (const OutputTarget& t : targets) {
+    std::unique_ptr<OutputWriter> wr(new OutputWriter());
+    // D6/D7 are only inputs in single layout; a streaming writer has no idle
+    // time to poll them in and its output is queued ms ahead anyway.
+    wr->prepare(t, makeOutputBackend(t));
+    if (opt.vsyncPin && !vsyncSource && t.kind == OutputKind::Ft245 && t.layout == Ft245Layout::Single) {
+      vsyncSource = true;
+      if (wr->streaming()) {
+        std::fprintf(stderr, "[vsync] %s streams turbo/macros; --vsync ignored\n", t.serial.c_str());
+      } else {
+        // Before the writer thread exists: it reads the mask unsynchronised.
+        gVsync.configure((uint8_t)(1u << opt.vsyncPin), opt.vsyncRising);
+        wr->setVsyncSource(true);
+        std::fprintf(stderr, "[vsync] %s D%d %s edge, read at +%d us, sample %d us before\n", t.serial.c_str(),
+          opt.vsyncPin, opt.vsyncRising ? "rising" : "falling", opt.vsyncOffsetUs, opt.vsyncLeadUs);
+      }
+    }
+    wr->start();
+    std::fprintf(stderr, "[out] started %s mode=%s VPad%d..%d idle=111111%s\n",
+      t.serial.c_str(), outputTargetMode(t), t.firstPad + 1, t.firstPad + wr->padCount(),
+      wr->streaming() ? " (waveform stream)" : "");
+    char part[96];
+    std::snprintf(part, sizeof(part), "%s%s:%s", gOutputSummary.empty() ? "" : " ",
+      t.serial.c_str(), outputTargetMode(t));
+    gOutputSummary += part;
+    gWriters.push_back(std::move(wr));
+  }
+  if (opt.vsyncPin && !vsyncSource) {
+    std::fprintf(stderr, "[vsync] needs a single-mode FT245 output (D6/D7 as inputs); --vsync ignored\n");
+  }
+  if (gWriters.empty()) {
+    std::fprintf(stderr, "[out] no outputs\n");
+    gOutputSummary = "Output: none";
+  } else {
+    gOutputSummary = "Output: " + gOutputSummary;
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Replay (main thread, no GLFW)
+// - Entries are applied at their recorded time relative to the replay start;
+//   between entries the thread just sleeps (1 ms steps).
+// - Pads the log has beyond what the devices carry are ignored; devices
+//   carrying more pads than the log get idle pads.
+// -----------------------------------------------------------------------------
+static int runReplay(const Options& opt) {
+  MappedFile f;
+  if (!f.open(opt.replayPath.c_str())) {
+    std::fprintf(stderr, "[replay] cannot map %s\n", opt.replayPath.c_str());
+    return 1;
+  }
+  const uint8_t* h = f.data();
+  if (f.size() < kRecHeaderSize || std::memcmp(h, kRecMagic, sizeof(kRecMagic)) != 0 || h[6] != kRecVersion) {
+    std::fprintf(stderr, "[replay] %s is not a usb2atari recording\n", opt.replayPath.c_str());
+    return 1;
+  }
+  const int padCount = h[7];
+  const uint32_t tickUs = (uint32_t)h[8] | ((uint32_t)h[9] << 8) | ((uint32_t)h[10] << 16) | ((uint32_t)h[11] << 24);
+  if (padCount < 1 || padCount > kMaxPads) {
+    std::fprintf(stderr, "[replay] bad pad count %d\n", padCount);
+    return 1;
+  }
+  std::fprintf(stderr, "[replay] %s: %d pad(s), recorded at %u us/tick, %llu bytes%s\n",
+    opt.replayPath.c_str(), padCount, tickUs, (unsigned long long)f.size(), opt.replayLoop ? " (loop)" : "");
+
+  // Writers open in the background; give them a moment so the start of the
+  // log is not played into a device that is still being reset.
+  const uint64_t tWait = nowNs();
+  for (;;) {
+    bool all = true;
+    for (const auto& wr : gWriters) all = all && wr->connected();
+    if (all || gQuit.load(std::memory_order_relaxed) || nowNs() - tWait > 2000000000ull) break;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  uint64_t entries = 0;
+  int pass = 0;
+  do {
+    ReplayCursor c;
+    c.p = h + kRecHeaderSize;
+    c.end = h + f.size();
+    c.padCount = padCount;
+    std::memset(c.bits6, 0x3F, sizeof(c.bits6));
+
+    uint8_t out[kMaxPads];
+    std::memset(out, 0x3F, sizeof(out));
+    const uint64_t start = nowNs();
+    while (!gQuit.load(std::memory_order_relaxed) && c.next()) {
+      // Sleep in <= 1 ms steps, re-offering the current state so a request
+      // staged behind a full writer queue still goes out (see submit()).
+      const uint64_t due = start + (uint64_t)c.tUs * 1000u;
+      for (uint64_t now = nowNs(); now < due; now = nowNs()) {
+        gPacer.sleepUntil((std::min)(due, now + 1000000u));
+        for (const auto& wr : gWriters) wr->submit(out, nowNs());
+      }
+      std::memcpy(out, c.bits6, sizeof(out));
+      for (const auto& wr : gWriters) wr->submit(out, nowNs());
+      ++entries;
     }
+    ++pass;
+    // A loop (or the end) returns the pads to idle first, so a recording
+    // that ends with a button held does not leave it stuck on.
+    std::memset(out, 0x3F, sizeof(out));
+    for (int i = 0; i < 3; ++i) {
+      for (const auto& wr : gWriters) wr->submit(out, nowNs());
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  } while (opt.replayLoop && !gQuit.load(std::memory_order_relaxed));
+
+  std::fprintf(stderr, "[replay] done: %d pass(es), %llu entries\n", pass, (unsigned long long)entries);
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+// UDP receiver (main thread, no GLFW)
+// - Blocks in recvfrom (100 ms timeout so quit and the idle timeout are seen)
+//   and hands every newly applied state straight to the FT245 writers.
+// -----------------------------------------------------------------------------
+static int runUdpReceiver(const Options& opt) {
+  sockaddr_storage addr;
+  socklen_t addrLen = 0;
+  if (!netInit() || !resolveUdp(opt.udpListen.c_str(), "0.0.0.0", true, addr, addrLen)) return 1;
+  SocketHandle sock = socket(addr.ss_family, SOCK_DGRAM, IPPROTO_UDP);
+  if (sock == kNoSocket || bind(sock, (const sockaddr*)&addr, addrLen) != 0) {
+    std::fprintf(stderr, "[net] cannot listen on %s\n", opt.udpListen.c_str());
+    if (sock != kNoSocket) closeSocket(sock);
+    return 1;
+  }
+#ifdef _WIN32
+  DWORD tv = 100;
+#else
+  timeval tv;
+  tv.tv_sec = 0;
+  tv.tv_usec = 100000;
 #endif
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (const char*)&tv, sizeof(tv));
+  std::fprintf(stderr, "[net] listening on %s\n", opt.udpListen.c_str());
+
+  uint64_t received = 0, applied = 0, stale = 0, lost = 0, malformed = 0, sessions = 0, timeouts = 0;
+  bool haveSession = false, idle = true;
+  uint32_t session = 0, lastSeq = 0;
+  uint64_t lastRxNs = 0;
+  uint8_t bits6[kMaxPads];
+  std::memset(bits6, 0x3F, sizeof(bits6));
+
+  while (!gQuit.load(std::memory_order_relaxed)) {
+    uint8_t pkt[256];
+    const int n = (int)recvfrom(sock, (char*)pkt, (int)sizeof(pkt), 0, nullptr, nullptr);
+    const uint64_t tRx = nowNs();
+
+    if (n <= 0) {
+      if (!idle && tRx - lastRxNs >= (uint64_t)kUdpTimeoutMs * 1000000ull) {
+        std::memset(bits6, 0x3F, sizeof(bits6));
+        for (const auto& wr : gWriters) wr->submit(bits6, tRx);
+        idle = true;
+        ++timeouts;
+        std::fprintf(stderr, "[net] no datagrams for %d ms, pads idle\n", kUdpTimeoutMs);
+      }
+      for (const auto& wr : gWriters) wr->submit(bits6, tRx);   // retry a staged state
+      continue;
+    }
+    ++received;
+    const int pads = n >= (int)kUdpHeaderSize ? pkt[3] : 0;
+    if (n < (int)kUdpHeaderSize || pkt[0] != 'U' || pkt[1] != '2' || pkt[2] != kUdpVersion ||
+        pads < 1 || pads > kMaxPads || n != (int)kUdpHeaderSize + pads) {
+      ++malformed;
+      continue;
+    }
+    uint32_t sess = 0, seq = 0;
+    for (int i = 0; i < 4; ++i) {
+      sess |= (uint32_t)pkt[4 + i] << (8 * i);
+      seq |= (uint32_t)pkt[8 + i] << (8 * i);
+    }
+    lastRxNs = tRx;
+
+    if (!haveSession || sess != session) {
+      if (haveSession) std::fprintf(stderr, "[net] new sender session %08x\n", sess);
+      haveSession = true;
+      session = sess;
+      lastSeq = seq - 1;
+      ++sessions;
+    }
+    // After a timeout accept the sender's current state even if it is a
+    // keepalive of a seq we already applied.
+    const int32_t ahead = (int32_t)(seq - lastSeq);
+    if (ahead <= 0 && !idle) {
+      ++stale;   // duplicate (redundant resend) or reordered
+      continue;
+    }
+    if (ahead > 1) lost += (uint64_t)(ahead - 1);
+    lastSeq = seq;
+    idle = false;
+
+    std::memset(bits6, 0x3F, sizeof(bits6));
+    std::memcpy(bits6, pkt + kUdpHeaderSize, (size_t)pads);
+    for (int p = 0; p < pads; ++p) bits6[p] &= 0x3Fu;
+    for (const auto& wr : gWriters) wr->submit(bits6, tRx);
+    ++applied;
+  }
 
-    // Render
-    int fbw = 0, fbh = 0;
-    glfwGetFramebufferSize(w, &fbw, &fbh);
+  std::memset(bits6, 0x3F, sizeof(bits6));
+  for (const auto& wr : gWriters) wr->submit(bits6, nowNs());
+  closeSocket(sock);
+  std::fprintf(stderr, "[net] receiver: %llu datagrams, %llu applied, %llu duplicate/late, %llu states skipped, "
+    "%llu malformed, %llu session(s), %llu timeout(s)\n",
+    (unsigned long long)received, (unsigned long long)applied, (unsigned long long)stale,
+    (unsigned long long)lost, (unsigned long long)malformed, (unsigned long long)sessions,
+    (unsigned long long)timeouts);
+  return 0;
+}
 
-    glDisable(GL_DEPTH_TEST);
-    glClearColor(0.08f, 0.09f, 0.11f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT);
+#ifndef USB2ATARI_NO_MAIN
+int main(int argc, char** argv) {
+  Options opt;
+  if (!parseArgs(argc, argv, opt)) return 2;
 
-    setOrtho(fbw, fbh);
+  if (opt.listDevices) {
+    printFt245Devices();
+    return 0;
+  }
+  if (opt.latencyTest > 0) {
+    return runLatencyTest(0, opt.probeIndex, opt.latencyTest);
+  }
 
-    float padW = fbw * 0.46f;
-    float padH = fbh * 0.70f;
-    float padY = fbh * 0.12f;
+  std::vector<OutputTarget> targets;
+  const int devicePads = resolveOutputTargets(opt, targets);
+  if (devicePads < 0) return 2;
+  gPadCount = opt.pads > 0 ? opt.pads : (std::max)(2, devicePads);
+  if (!opt.udpSend.empty()) {
+    OutputTarget t;   // firstPad 0: every pad goes over the network too
+    t.kind = OutputKind::Udp;
+    t.serial = opt.udpSend;
+    t.pads = gPadCount;
+    targets.push_back(t);
+  }
 
-    float pad0X = fbw * 0.04f;
-    float pad1X = fbw * 0.50f;
+  std::signal(SIGINT, onSignal);
+  std::signal(SIGTERM, onSignal);
+
+  // Main thread = I/O loop (or replay / receiver); writers read gRealtime.
+  gRealtime = opt.realtime;
+  gPacer.open(opt.spinUs);
+  gMinPulseUs = opt.minPulseUs;
+  if (gMinPulseUs >= 0) gPressLatch.setMinPulseNs((uint64_t)gMinPulseUs * 1000u);
+
+  if (!opt.replayPath.empty() || !opt.udpListen.empty()) {
+    startOutputWriters(opt, targets);
+    if (!opt.statsFile.empty()) gSampler.start(opt.statsFile, opt.statsFormat, opt.statsIntervalMs);
+    raiseIoThread(opt.realtime, opt.cpu);
+    const int rc = opt.replayPath.empty() ? runUdpReceiver(opt) : runReplay(opt);
+    gSampler.stop();
+    dumpDeviceLatencyStats(stderr);
+    gWriters.clear();
+    return rc;
+  }
 
-    drawPadDiagram(pad0X, padY, padW, padH, s0, gPad[0], 0, (gEditPad == 0));
-    drawPadDiagram(pad1X, padY, padW, padH, s1, gPad[1], 1, (gEditPad == 1));
+  std::memset(gKeyDown, 0, sizeof(gKeyDown));
+  std::memset(gKeyDownPrev, 0, sizeof(gKeyDownPrev));
 
-    drawUIOverlay(fbw, fbh);
+  glfwSetErrorCallback(onError);
+  if (!glfwInit()) {
+    std::fprintf(stderr, "glfwInit failed\n");
+    return 1;
+  }
 
-    glfwSwapBuffers(w);
+  GLFWwindow* w = nullptr;
+  if (!opt.headless) {
+    // Portable fixed pipeline context
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 2);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+
+    w = glfwCreateWindow(1200, 700, "padviz", nullptr, nullptr);
+    if (!w) {
+      std::fprintf(stderr, "glfwCreateWindow failed\n");
+      glfwTerminate();
+      return 1;
+    }
 
-    // Update key previous states last
-    updateKeyPrev();
+    glfwSetKeyCallback(w, onKey);
+    glfwSetFramebufferSizeCallback(w, onFramebufferSize);
+    glfwSetWindowRefreshCallback(w, onWindowRefresh);
+
+    int fbw = 0, fbh = 0;
+    glfwGetFramebufferSize(w, &fbw, &fbh);
+    onFramebufferSize(w, fbw, fbh);
+  }
+  glfwSetJoystickCallback(onJoystick);
+  attachPresentJoysticks();
+
+  setDefaultBindings();
+  if (loadMappings()) { // if exists, override defaults
+    std::fprintf(stderr, "[map] loaded from %s\n", kMapFile);
+  } else if (opt.headless) {
+    std::fprintf(stderr, "[map] %s not found, using default bindings\n", kMapFile);
+  }
+
+  gMapFiles.start();
+
+  if (opt.input == InputSource::Native && !gNativeInput.start()) {
+    std::fprintf(stderr, "[hid] no native input source on this platform, GLFW joysticks only\n");
+  }
+
+  if (!opt.tracePath.empty()) {
+    gTraceDumper.start(opt.tracePath, opt.traceThresholdUs);
+  } else if (opt.traceThresholdUs) {
+    std::fprintf(stderr, "[trace] --trace-threshold-us needs --trace FILE; ignored\n");
+  }
+  startOutputWriters(opt, targets);
+  if (w || !opt.statsFile.empty()) gSampler.start(opt.statsFile, opt.statsFormat, opt.statsIntervalMs);
+  if (!opt.recordPath.empty()) {
+    gRecorder.open(opt.recordPath.c_str(), gPadCount, (uint32_t)(1000000 / opt.rateHz));
+  }
+
+  std::thread renderThread;
+  if (w) {
+    uint8_t idle[kMaxPads];
+    std::memset(idle, 0x3F, sizeof(idle));
+    publishUi(idle);
+    gUiMaxFps = opt.uiFps;
+    renderThread = std::thread(renderThreadMain, w);
   }
 
+  raiseIoThread(opt.realtime, opt.cpu);
+  runIoLoop(w, opt);
+
+  gQuit.store(true, std::memory_order_relaxed);
+  { std::lock_guard<std::mutex> lock(gUiWakeM); }
+  gUiCv.notify_all();
+  if (renderThread.joinable()) renderThread.join();
+  gSampler.stop();
+  gRecorder.close();
+  gTraceDumper.stop();
+  gMapFiles.stop();
+
+  dumpLatencyStats(stderr);
+  dumpDeviceLatencyStats(stderr);
+  gNativeInput.stop();
 #if 1
-  gFt245.close();
+  gWriters.clear();  // stops writer threads, restores idle, closes devices
 #endif
-  glfwDestroyWindow(w);
+  if (w) glfwDestroyWindow(w);
   glfwTerminate();
+  std::fprintf(stderr, "[io] stopped\n");
   return 0;
 }
+#endif // USB2ATARI_NO_MAIN